@@ -0,0 +1,647 @@
+/*
+Example for LoRa Click
+
+    Date          : Feb 2018.
+    Author        : MikroE Team
+
+Test configuration Linux :
+
+    Host             : any Linux PC or CI runner
+    Compiler         : gcc -std=gnu99 -O2 -D__HAL_SIM__
+                       -I../../../library -I../../../library/HAL
+                       Click_LoRa_SIM.c ../../../library/__lora_driver.c
+
+---
+Description :
+
+Measures the driver hot paths against the simulated module, no hardware needed.
+
+- Receive path - downlink lines are fed through lora_rx_isr and parsed by
+lora_process, cost of the interrupt routine and of the line parser is reported
+separately
+- Keyword lookup - response corpus classified by the first and second
+response strcmp lists the driver used before, copied unchanged, and by the
+perfect hash lookup of lora_rsp_code, codes are checked against the old
+results through a mapping table. On a desktop CPU the lookup is no faster
+than the chain ( x0.7 ~ x1.1 between builds ), most keywords are rejected by
+the chain at the first byte
+- Long downlinks - radio_rx lines longer than the receive ring read from the
+polled HAL, every downlink must arrive whole
+- Transmit path - binary payloads are assembled, hex encoded and streamed to
+the UART, module answers without delay so only driver time is measured. Text
+mac tx command is swept over 1 .. 242 byte payloads, time per command must
+grow linearly with the payload
+- Session - scripted join and uplink session with module timing, reports
+commands per second and latency in simulated time
+- Continuous receive - radio rx re-armed by the driver after every frame,
+frames per second and dead time between receive windows in simulated time
+- Transmit burst - table of frames sent back to back with radio tx, frames
+per second and per frame latency in simulated time
+- Aggregation - records packed into full 222 byte mac tx frames at SF7, every
+frame must go out whole
+- Fragmentation - blob larger than a frame sent as full size fragments at SF7
+- Payload codec - compression ratio and encode / decode time of slowly
+changing telemetry records, with and without LZ pass
+- Parity frames - radio tx frames over a lossy channel, module loses frames
+at the configured rate, share of delivered frames and goodput ( delivered
+payload per second of airtime at SF7, every frame pays its preamble and PHY
+header ) with and without one parity frame per window. With independent
+losses parity raises the share of delivered frames, not the goodput
+
+Driver uses only the storage inside the context, there are no allocations to
+report.
+
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+#include "__lora_driver.h"
+
+#define RX_LINES        100000
+#define KW_ROUNDS       200000
+#define TX_COMMANDS     20000
+#define TX_SWEEP_MAX    242
+#define TX_SWEEP_ROUNDS 500
+#define LONG_RX_COUNT   100
+#define LONG_RX_SIZE    255
+#define SESSION_UPLINKS 200
+#define STREAM_FRAMES   500
+#define BURST_FRAMES    200
+#define AGG_RECORDS     120
+#define AGG_RECORD      36
+#define FRAG_BLOB       1000
+#define PACK_RECORDS    100000
+#define FEC_FRAMES      20000
+#define FEC_PAYLOAD     32
+#define FEC_SF          7
+
+T_lora_ctx lora;
+T_lora_downlink downlink;
+T_lora_frame burst[ BURST_FRAMES ];
+bool burst_f;
+uint32_t agg_frames;
+uint32_t agg_failed;
+uint8_t frag_status;
+bool frag_f;
+uint8_t blob[ FRAG_BLOB ];
+char tmp_txt[ 50 ];
+uint8_t payload[ 64 ];
+char *kw_lines[] =
+{
+    "ok", "invalid_param", "not_joined", "no_free_ch", "silent",
+    "frame_counter_err_rejoin_needed", "busy", "mac_paused", "invalid_data_len",
+    "keys_not_init", "mac_err", "mac_tx_ok", "mac_rx", "radio_err",
+    "radio_tx_ok", "radio_rx", "accepted", "denied",
+    "RN2483 1.0.1 Dec 15 2015 09:38:09", "4294967245"
+};
+char tx_hex[ 2 * TX_SWEEP_MAX + 1 ];
+char rx_line[] = "mac_rx 1 000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F\r\n";
+uint32_t rx_count;
+
+uint64_t nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint64_t )ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint32_t simNow()
+{
+    return hal_simNow( lora.bus ) / 1000;
+}
+
+void lora_cbk( T_lora_ctx *ctx, char* response )
+{
+    rx_count++;
+}
+
+void moduleInit( T_hal_simCfg *cfg )
+{
+    T_LORA_P uart = hal_simOpen( cfg );
+
+    lora_uartDriverInit( &lora, hal_simGpio(), uart );
+    lora_init( &lora, 0, &lora_cbk );
+    lora_tick_conf( &lora, 0 );
+}
+
+void benchRx()
+{
+    T_hal_simCfg    cfg = { 0, 0, 0, 0, 1, 0, 0, 0 };
+    uint64_t        isr_ns = 0;
+    uint64_t        par_ns = 0;
+    uint64_t        start;
+    uint32_t        len = sizeof( rx_line ) - 1;
+    uint32_t        i;
+    uint32_t        j;
+
+    moduleInit( &cfg );
+
+    for( i = 0; i < RX_LINES; i++ )
+    {
+        start = nowNs();
+        for( j = 0; j < len; j++ )
+            lora_rx_isr( &lora, rx_line[ j ] );
+        isr_ns += nowNs() - start;
+
+        start = nowNs();
+        lora_process( &lora );
+        par_ns += nowNs() - start;
+    }
+
+    printf( "rx isr    : %6.1f ns/byte  %8.1f MB/s\n",
+            ( double )isr_ns / ( ( double )RX_LINES * len ),
+            ( double )RX_LINES * len * 1000.0 / isr_ns );
+    printf( "rx parse  : %6.1f ns/line  %8.1f MB/s  ( %u lines )\n",
+            ( double )par_ns / RX_LINES,
+            ( double )RX_LINES * len * 1000.0 / par_ns, rx_count );
+}
+
+/* Response matching of the driver before the keyword table, verbatim */
+static char *_rx_buffer;
+
+static int8_t _strcmp(char* s1, char* s2)
+{
+    while(*s1 && (*s1==*s2))
+        s1++,s2++;
+    return *( unsigned char*)s1-*( unsigned char*)s2;
+}
+
+static uint8_t _lora_par()
+{
+    if( !_strcmp( _rx_buffer, "invalid_param" ) )
+        return 1;
+    if( !_strcmp( _rx_buffer, "not_joined" ) )
+        return 2;
+    if( !_strcmp( _rx_buffer, "no_free_ch" ) )
+        return 3;
+    if( !_strcmp( _rx_buffer, "silent" ) )
+        return 4;
+    if( !_strcmp( _rx_buffer, "frame_counter_err_rejoin_needed" ) )
+        return 5;
+    if( !_strcmp( _rx_buffer, "busy" ) )
+        return 6;
+    if( !_strcmp( _rx_buffer, "mac_paused" ) )
+        return 7;
+    if( !_strcmp( _rx_buffer, "invalid_data_len" ) )
+        return 8;
+    if( !_strcmp( _rx_buffer, "keys_not_init" ) )
+        return 9;
+    return 0;
+}
+static uint8_t _lora_repar()
+{
+    if( !_strcmp( _rx_buffer, "mac_err" ) )
+        return 10;
+    if( !_strcmp( _rx_buffer, "mac_tx_ok" ) )
+        return 0;
+    if( !_strcmp( _rx_buffer, "mac_rx" ) )
+        return 12;
+    if( !_strcmp( _rx_buffer, "invalid_data_len" ) )
+        return 13;
+    if( !_strcmp( _rx_buffer, "radio_err" ) )
+        return 14;
+    if( !_strcmp( _rx_buffer, "radio_tx_ok" ) )
+        return 0;
+    if( !_strcmp( _rx_buffer, "radio_rx" ) )
+        return 0;
+    if( !_strcmp( _rx_buffer, "accepted" ) )
+        return 0;
+    if( !_strcmp( _rx_buffer, "denied" ) )
+        return 18;
+    return 0;
+}
+
+/* What the old first / second response matching returned for each code */
+const uint8_t kw_old[ LORA_RSP_OTHER + 1 ][ 2 ] =
+{
+    {  0,  0 },     /* LORA_RSP_OK */
+    {  1,  0 },     /* LORA_RSP_INVALID_PARAM */
+    {  2,  0 },     /* LORA_RSP_NOT_JOINED */
+    {  3,  0 },     /* LORA_RSP_NO_FREE_CH */
+    {  4,  0 },     /* LORA_RSP_SILENT */
+    {  5,  0 },     /* LORA_RSP_FRAME_COUNTER_ERR */
+    {  6,  0 },     /* LORA_RSP_BUSY */
+    {  7,  0 },     /* LORA_RSP_MAC_PAUSED */
+    {  8, 13 },     /* LORA_RSP_INVALID_DATA_LEN */
+    {  9,  0 },     /* LORA_RSP_KEYS_NOT_INIT */
+    {  0, 10 },     /* LORA_RSP_MAC_ERR */
+    {  0,  0 },     /* LORA_RSP_MAC_TX_OK */
+    {  0, 12 },     /* LORA_RSP_MAC_RX */
+    {  0,  0 },     /* LORA_RSP_TX_INVALID_DATA_LEN, never received */
+    {  0, 14 },     /* LORA_RSP_RADIO_ERR */
+    {  0,  0 },     /* LORA_RSP_RADIO_TX_OK */
+    {  0,  0 },     /* LORA_RSP_RADIO_RX */
+    {  0,  0 },     /* LORA_RSP_ACCEPTED */
+    {  0, 18 },     /* LORA_RSP_DENIED */
+    {  0,  0 }      /* LORA_RSP_OTHER */
+};
+
+void benchKeyword()
+{
+    uint32_t            count = sizeof( kw_lines ) / sizeof( kw_lines[ 0 ] );
+    uint32_t            mismatch = 0;
+    volatile uint32_t   sum = 0;
+    uint64_t            par_ns;
+    uint64_t            repar_ns;
+    uint64_t            hash_ns;
+    uint64_t            start;
+    uint32_t            i;
+    uint32_t            j;
+    uint8_t             code;
+
+    /* Code must map to what both old lists returned for the same line */
+    for( i = 0; i < count; i++ )
+    {
+        _rx_buffer = kw_lines[ i ];
+        code = lora_rsp_code( kw_lines[ i ] );
+        if( ( _lora_par() != kw_old[ code ][ 0 ] ) || ( _lora_repar() != kw_old[ code ][ 1 ] ) )
+            mismatch++;
+    }
+
+    /* Old driver matched a line against one list, first or second response */
+    start = nowNs();
+    for( i = 0; i < KW_ROUNDS; i++ )
+        for( j = 0; j < count; j++ )
+        {
+            _rx_buffer = kw_lines[ j ];
+            sum += _lora_par();
+        }
+    par_ns = nowNs() - start;
+
+    start = nowNs();
+    for( i = 0; i < KW_ROUNDS; i++ )
+        for( j = 0; j < count; j++ )
+        {
+            _rx_buffer = kw_lines[ j ];
+            sum += _lora_repar();
+        }
+    repar_ns = nowNs() - start;
+
+    start = nowNs();
+    for( i = 0; i < KW_ROUNDS; i++ )
+        for( j = 0; j < count; j++ )
+            sum += lora_rsp_code( kw_lines[ j ] );
+    hash_ns = nowNs() - start;
+
+    printf( "keyword   : strcmp chain %5.1f / %5.1f ns/line  hash %5.1f ns/line  x%.1f / x%.1f  mismatch %u\n",
+            ( double )par_ns / ( ( double )KW_ROUNDS * count ),
+            ( double )repar_ns / ( ( double )KW_ROUNDS * count ),
+            ( double )hash_ns / ( ( double )KW_ROUNDS * count ),
+            ( double )par_ns / hash_ns, ( double )repar_ns / hash_ns, mismatch );
+}
+
+void benchLongRx()
+{
+    T_hal_simCfg    cfg = { 2000, 0, 20000, 20, 1, 0, 0, LONG_RX_SIZE };
+    T_lora_rxStats  stats;
+    uint32_t        whole = 0;
+    uint32_t        i;
+
+    moduleInit( &cfg );
+    lora_time_conf( &lora, simNow );
+    lora_tick_conf( &lora, LORA_TIMEOUT_CMD );
+
+    for( i = 0; i < LONG_RX_COUNT; i++ )
+        if( !lora_rx_bin( &lora, "5000", &downlink ) && ( downlink.len == LONG_RX_SIZE ) )
+            whole++;
+    lora_rx_stats( &lora, &stats );
+
+    printf( "long rx   : %u/%u downlinks of %u bytes whole  ring high water %u/%u  overflow %u\n",
+            whole, LONG_RX_COUNT, LONG_RX_SIZE, stats.high_water, LORA_RX_RING_SIZE, stats.overflow );
+}
+
+void benchTx()
+{
+    T_hal_simCfg    cfg = { 0, 0, 0, 0, 1, 0, 0, 0 };
+    uint64_t        sweep[ TX_SWEEP_MAX + 1 ];
+    uint64_t        start;
+    uint32_t        i;
+    uint32_t        len;
+    uint8_t         res = 0;
+
+    moduleInit( &cfg );
+
+    for( i = 0; i < sizeof( payload ); i++ )
+        payload[ i ] = i * 7;
+
+    start = nowNs();
+    for( i = 0; i < TX_COMMANDS; i++ )
+        lora_tx_bin( &lora, payload, sizeof( payload ) );
+    start = nowNs() - start;
+
+    printf( "radio tx  : %6.1f ns/cmd   %8.1f MB/s payload\n",
+            ( double )start / TX_COMMANDS,
+            ( double )TX_COMMANDS * sizeof( payload ) * 1000.0 / start );
+
+    /* Text command builder, mac tx with 1 .. TX_SWEEP_MAX byte payloads */
+    for( i = 0; i < 2 * TX_SWEEP_MAX; i++ )
+        tx_hex[ i ] = "0123456789ABCDEF"[ ( i * 7 ) & 15 ];
+    lora_join( &lora, "otaa", &tmp_txt[0] );
+
+    for( len = 1; len <= TX_SWEEP_MAX; len++ )
+    {
+        tx_hex[ 2 * len ] = '\0';
+        start = nowNs();
+        for( i = 0; i < TX_SWEEP_ROUNDS; i++ )
+            res |= lora_mac_tx( &lora, "uncnf ", "1", &tx_hex[0], &tmp_txt[0] );
+        sweep[ len ] = ( nowNs() - start ) / TX_SWEEP_ROUNDS;
+        tx_hex[ 2 * len ] = "0123456789ABCDEF"[ ( 2 * len * 7 ) & 15 ];
+    }
+
+    printf( "mac tx    : %u..%u bytes  status %u  ns/cmd", 1, TX_SWEEP_MAX, res );
+    for( len = 1; len <= TX_SWEEP_MAX; len *= 2 )
+        printf( "  %u:%llu", len, ( unsigned long long )sweep[ len ] );
+    printf( "  %u:%llu  %u:%llu\n", 222, ( unsigned long long )sweep[ 222 ],
+            TX_SWEEP_MAX, ( unsigned long long )sweep[ TX_SWEEP_MAX ] );
+}
+
+void benchSession()
+{
+    T_hal_simCfg    cfg = { 2000, 61700, 1000000, 20, 1, 5, 20, 8 };
+    T_LORA_P        uart;
+    T_hal_simStats  stats;
+    uint32_t        start;
+    uint32_t        worst = 0;
+    uint32_t        sum = 0;
+    uint32_t        errors = 0;
+    uint32_t        i;
+    uint8_t         res;
+
+    moduleInit( &cfg );
+    uart = lora.bus;
+
+    lora_cmd( &lora, &LORA_CMD_SYS_GET_VER[0], &tmp_txt[0] );
+    lora_join( &lora, "otaa", &tmp_txt[0] );
+
+    for( i = 0; i < SESSION_UPLINKS; i++ )
+    {
+        start = hal_simNow( uart );
+        res = lora_mac_tx_bin( &lora, 1, payload, 11, false, &downlink );
+        start = hal_simNow( uart ) - start;
+
+        if( res && ( res != LORA_RSP_MAC_RX ) )
+            errors++;
+        sum += start;
+        if( start > worst )
+            worst = start;
+    }
+    hal_simStats( uart, &stats );
+
+    printf( "session   : %6.2f cmd/s  latency avg %u us  max %u us  errors %u/%u\n",
+            ( double )stats.commands * 1000000.0 / hal_simNow( uart ),
+            sum / SESSION_UPLINKS, worst, errors, SESSION_UPLINKS );
+}
+
+void stream_cbk( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
+{
+    if( !status && downlink.len )
+        rx_count++;
+}
+
+void benchStream()
+{
+    T_hal_simCfg        cfg = { 2000, 0, 20000, 20, 1, 5, 0, 16 };
+    T_lora_streamStats  stats;
+    T_LORA_P            uart;
+
+    moduleInit( &cfg );
+    uart = lora.bus;
+    lora_time_conf( &lora, simNow );
+    rx_count = 0;
+
+    lora_cmd( &lora, &LORA_CMD_MAC_PAUSE[0], &tmp_txt[0] );
+    lora_cmd( &lora, &LORA_CMD_RADIO_SET_WDT[0], &tmp_txt[0] );
+
+    lora_rx_stream( &lora, &downlink, stream_cbk );
+    while( rx_count < STREAM_FRAMES )
+        lora_process( &lora );
+    lora_rx_stream_stats( &lora, &stats );
+
+    printf( "rx stream : %6.2f frames/s  windows %u  errors %u  dead time avg %.2f ms  max %u ms\n",
+            ( double )stats.frames * 1000000.0 / hal_simNow( uart ), stats.windows, stats.errors,
+            ( double )stats.gap_total / ( stats.windows - 1 ), stats.gap_max );
+}
+
+void burst_cbk( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
+{
+    burst_f = true;
+}
+
+void benchBurst()
+{
+    T_hal_simCfg        cfg = { 2000, 61700, 0, 20, 1, 0, 0, 0 };
+    T_lora_burstStats   stats;
+    uint32_t            i;
+
+    moduleInit( &cfg );
+    lora_time_conf( &lora, simNow );
+
+    for( i = 0; i < BURST_FRAMES; i++ )
+    {
+        burst[ i ].data = payload;
+        burst[ i ].len  = 32;
+    }
+
+    burst_f = false;
+    lora_tx_burst( &lora, burst, BURST_FRAMES, LORA_LANE_NORMAL, burst_cbk );
+    while( !burst_f )
+        lora_process( &lora );
+    lora_tx_burst_stats( &lora, &stats );
+
+    printf( "tx burst  : %6.2f frames/s  latency avg %.2f ms  max %u ms  ( %u frames )\n",
+            ( double )stats.frames * 1000.0 / stats.elapsed,
+            ( double )stats.lat_total / stats.frames, stats.lat_max, stats.frames );
+}
+
+void agg_cbk( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
+{
+    agg_frames++;
+    if( status )
+        agg_failed++;
+}
+
+void benchAgg()
+{
+    T_hal_simCfg    cfg = { 2000, 370000, 1000000, 20, 1, 0, 0, 0 };
+    T_hal_simStats  stats;
+    uint32_t        i;
+
+    moduleInit( &cfg );
+    lora_join( &lora, "otaa", &tmp_txt[0] );
+
+    /* SF7 - six records with their length bytes fill the 222 byte frame */
+    lora_airtime_conf( &lora, 7, 125, 5 );
+    lora_agg_conf( &lora, 1, false, 0, agg_cbk );
+
+    for( i = 0; i < AGG_RECORDS; i++ )
+        while( !lora_agg_add( &lora, payload, AGG_RECORD, false ) )
+            lora_process( &lora );
+    lora_agg_flush( &lora );
+    while( agg_frames < AGG_RECORDS / ( 222 / ( AGG_RECORD + 1 ) ) )
+        lora_process( &lora );
+    hal_simStats( lora.bus, &stats );
+
+    printf( "aggregate : %u records in %u frames of %u bytes  failed %u\n",
+            AGG_RECORDS, agg_frames, stats.tx_bytes / agg_frames, agg_failed );
+}
+
+void frag_cbk( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
+{
+    frag_status = status;
+    frag_f      = true;
+}
+
+void benchFrag()
+{
+    T_hal_simCfg    cfg = { 2000, 370000, 1000000, 20, 1, 0, 0, 0 };
+    T_hal_simStats  start;
+    T_hal_simStats  stats;
+    uint32_t        i;
+
+    moduleInit( &cfg );
+    lora_join( &lora, "otaa", &tmp_txt[0] );
+    lora_airtime_conf( &lora, 7, 125, 5 );
+
+    for( i = 0; i < FRAG_BLOB; i++ )
+        blob[ i ] = i * 13;
+
+    /* SF7 - fragments of 219 bytes plus the 3 byte header fill the frame */
+    hal_simStats( lora.bus, &start );
+    frag_f = false;
+    lora_frag_send( &lora, 1, blob, FRAG_BLOB, false, frag_cbk );
+    while( !frag_f )
+        lora_process( &lora );
+    hal_simStats( lora.bus, &stats );
+
+    printf( "fragments : %u byte blob in %u uplinks  %u bytes sent  status %u\n",
+            FRAG_BLOB, stats.commands - start.commands, stats.tx_bytes - start.tx_bytes, frag_status );
+}
+
+void benchPackRun( bool lz )
+{
+    T_lora_pack     pack;
+    T_lora_unpack   unpack;
+    int32_t         values[ 8 ];
+    int32_t         decoded[ 8 ];
+    uint8_t         frame[ 64 ];
+    uint64_t        enc_ns = 0;
+    uint64_t        dec_ns = 0;
+    uint64_t        start;
+    uint32_t        bytes = 0;
+    uint32_t        seed = 1;
+    uint32_t        i;
+    uint8_t         j;
+    uint8_t         len;
+
+    lora_pack_init( &pack );
+    lora_unpack_init( &unpack );
+
+    for( j = 0; j < 8; j++ )
+        values[ j ] = 20000 + j * 1500;
+
+    for( i = 0; i < PACK_RECORDS; i++ )
+    {
+        /* Sensors drift by a few counts between samples */
+        for( j = 0; j < 8; j++ )
+        {
+            seed = seed * 1103515245UL + 12345UL;
+            values[ j ] += ( int32_t )( ( seed >> 16 ) % 15 ) - 7;
+        }
+
+        start = nowNs();
+        len = lora_pack_encode( &pack, values, 8, lz, frame, sizeof( frame ) );
+        enc_ns += nowNs() - start;
+
+        start = nowNs();
+        lora_pack_decode( &unpack, frame, len, decoded );
+        dec_ns += nowNs() - start;
+
+        lora_pack_ack( &pack );
+        bytes += len;
+    }
+
+    printf( "pack %s : %5.2f bytes/record ( raw 32, ratio %.2f )  encode %6.1f ns  decode %6.1f ns\n",
+            lz ? "lz" : "  ", ( double )bytes / PACK_RECORDS, 32.0 * PACK_RECORDS / bytes,
+            ( double )enc_ns / PACK_RECORDS, ( double )dec_ns / PACK_RECORDS );
+}
+
+void benchFecRun( uint8_t window, uint8_t loss )
+{
+    T_hal_simCfg    cfg = { 0, 0, 0, 0, 7, loss, 0, 0 };
+    T_lora_fec      fec;
+    T_lora_unfec    unfec;
+    uint8_t         data[ FEC_PAYLOAD ];
+    uint8_t         frame[ LORA_FEC_SIZE + 1 + LORA_FEC_HDR ];
+    uint8_t         out[ LORA_FEC_SIZE ];
+    uint32_t        air = 0;
+    uint32_t        air_raw = 0;
+    uint32_t        delivered = 0;
+    uint32_t        raw = 0;
+    uint32_t        i;
+    uint8_t         index;
+    uint8_t         len;
+    uint8_t         j;
+
+    /* Module reports a frame lost on the channel with radio_err */
+    moduleInit( &cfg );
+    lora_fec_init( &fec, window );
+    lora_unfec_init( &unfec );
+
+    for( i = 0; i < FEC_FRAMES; i++ )
+    {
+        for( j = 0; j < FEC_PAYLOAD; j++ )
+            data[ j ] = i + j;
+
+        /* Without parity - bare payload, preamble and PHY header still paid */
+        air_raw += lora_toa( FEC_SF, 125, 5, FEC_PAYLOAD );
+        if( !lora_tx_bin( &lora, data, FEC_PAYLOAD ) )
+            raw++;
+
+        len = lora_fec_encode( &fec, data, FEC_PAYLOAD, frame );
+
+        /* Data frame and parity frame of a complete group */
+        do
+        {
+            air += lora_toa( FEC_SF, 125, 5, len );
+            if( !lora_tx_bin( &lora, frame, len ) )
+            {
+                if( lora_fec_decode( &unfec, frame, len ) )
+                    delivered++;
+                if( lora_fec_recover( &unfec, out, &index ) )
+                    delivered++;
+            }
+            len = lora_fec_parity( &fec, frame );
+        }
+        while( len );
+    }
+
+    printf( "fec w%-2u loss %2u%% : delivered %5.1f%% ( without parity %5.1f%% )  goodput %5.1f B/s ( without %5.1f B/s )\n",
+            window, loss, 100.0 * delivered / FEC_FRAMES, 100.0 * raw / FEC_FRAMES,
+            ( double )delivered * FEC_PAYLOAD * 1000.0 / air,
+            ( double )raw * FEC_PAYLOAD * 1000.0 / air_raw );
+}
+
+int main()
+{
+    benchRx();
+    benchKeyword();
+    benchLongRx();
+    benchTx();
+    benchSession();
+    benchStream();
+    benchBurst();
+    benchAgg();
+    benchFrag();
+    benchPackRun( false );
+    benchPackRun( true );
+    benchFecRun( 4, 1 );
+    benchFecRun( 4, 5 );
+    benchFecRun( 4, 10 );
+    benchFecRun( 4, 20 );
+    benchFecRun( 8, 5 );
+    benchFecRun( 8, 10 );
+
+    return 0;
+}
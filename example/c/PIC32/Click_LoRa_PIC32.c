@@ -36,6 +36,8 @@ uint8_t send_data;
 uint8_t _data;
 uint8_t rxState;
 uint8_t txState;
+T_lora_downlink downlink;
+T_lora_ctx lora;
 
 void systemInit()
 {
@@ -48,33 +50,33 @@ void systemInit()
     mikrobus_logWrite("--- System init ---", _LOG_LINE );
 }
 
-void lora_cbk( char* response )
+void lora_cbk( T_lora_ctx *ctx, char* response )
 {
 
 }
 void applicationInit()
 {
-    lora_uartDriverInit( (T_LORA_P)&_MIKROBUS1_GPIO, (T_LORA_P)&_MIKROBUS1_UART );
-    lora_init( 0, &lora_cbk );
+    lora_uartDriverInit( &lora, (T_LORA_P)&_MIKROBUS1_GPIO, (T_LORA_P)&_MIKROBUS1_UART );
+    lora_init( &lora, 0, &lora_cbk );
     // start
-    lora_cmd( &LORA_CMD_SYS_GET_VER[0], &tmp_txt[0] );
-    lora_cmd( &LORA_CMD_MAC_PAUSE[0],  &tmp_txt[0] );
+    lora_cmd( &lora, &LORA_CMD_SYS_GET_VER[0], &tmp_txt[0] );
+    lora_cmd( &lora, &LORA_CMD_MAC_PAUSE[0],  &tmp_txt[0] );
     mikrobus_logWrite("mac pause",_LOG_LINE);
     mikrobus_logWrite(&tmp_txt[0],_LOG_LINE);
 
-    lora_cmd( &LORA_CMD_RADIO_SET_WDT[0], &tmp_txt[0] );
+    lora_cmd( &lora, &LORA_CMD_RADIO_SET_WDT[0], &tmp_txt[0] );
     mikrobus_logWrite("radio set wdt 0",_LOG_LINE);
     mikrobus_logWrite(&tmp_txt[0],_LOG_LINE);
 }
 
 void applicationTask()
 {
-    lora_process();
+    lora_process( &lora );
 // RECEIVER
-    rxState = lora_rx( &LORA_ARG_0[0], &tmp_txt[0]);
-    if( rxState == 0)
+    rxState = lora_rx_bin( &lora, &LORA_ARG_0[0], &downlink );
+    if( ( rxState == 0 ) && downlink.len )
     {
-        _data = xtoi(&tmp_txt[11]);
+        _data = downlink.data[0];
         mikrobus_logWrite( &_data,_LOG_BYTE);
         mikrobus_logWrite( " ",_LOG_LINE);
     }
@@ -84,7 +86,7 @@ void applicationTask()
     {
         send_data = sendMessage[cnt];
         IntToHex(send_data,sendHex);
-        txState = lora_tx( &sendHex[0] );
+        txState = lora_tx( &lora, &sendHex[0] );
         if( txState == 0)
         {
             mikrobus_logWrite( "  Response : ",_LOG_TEXT );
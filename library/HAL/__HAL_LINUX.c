@@ -0,0 +1,326 @@
+/*
+    __HAL_LINUX.c
+
+-----------------------------------------------------------------------------
+
+  This file is part of mikroSDK.
+
+  Copyright (c) 2017, MikroElektonika - http://www.mikroe.com
+
+  All rights reserved.
+
+----------------------------------------------------------------------------- */
+
+/**
+@file   __HAL_LINUX.c
+@brief  Linux HAL
+@{
+
+Runs the driver on a Linux host, module is connected through a tty ( USB
+serial adapter, on board UART ) or a pty.
+
+Receive side is buffered - when the buffer runs empty hal_uartReady asks
+epoll whether anything arrived and refills the buffer with one non-blocking
+read(), so lora_process drains everything that arrived with a single read.
+Transmit side collects bytes until the line end written by the driver and
+sends the whole command with one write(), a full output queue is waited for
+on the same epoll instance.
+
+@}
+*/
+/* -------------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+
+/* ------------------------------------------------------------------- MACROS */
+
+/**
+ * Number of UARTs that can be opened */
+#ifndef HAL_LINUX_UART_COUNT
+#define HAL_LINUX_UART_COUNT    4
+#endif
+/**
+ * Size of receive and transmit buffers */
+#define HAL_LINUX_BUF_SIZE      256
+/**
+ * Longest wait for room in the output queue ( ms ), rest of the line is dropped */
+#ifndef HAL_LINUX_TX_WAIT
+#define HAL_LINUX_TX_WAIT       1000
+#endif
+
+/* ---------------------------------------------------------------- VARIABLES */
+
+typedef struct
+{
+    int         fd;
+    int         epfd;
+
+    uint8_t     rx_buf[ HAL_LINUX_BUF_SIZE ];
+    uint16_t    rx_pos;
+    uint16_t    rx_len;
+
+    uint8_t     tx_buf[ HAL_LINUX_BUF_SIZE ];
+    uint16_t    tx_len;
+
+}T_hal_uartObj;
+
+static T_hal_uartObj    _hal_uart[ HAL_LINUX_UART_COUNT ];
+static uint8_t          _hal_uart_count;
+static T_hal_uartObj*   _hal_uart_cur;
+
+static T_hal_gpioObj    _hal_gpio;
+static uint8_t          _hal_gpio_f;
+
+/* -------------------------------------------- PRIVATE FUNCTION DEFINITIONS */
+
+static speed_t _hal_speed( uint32_t baud )
+{
+    switch( baud )
+    {
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+    }
+    /* Not a termios rate */
+    return B0;
+}
+
+static uint8_t _hal_txWait( T_hal_uartObj *uart )
+{
+    struct epoll_event  ev;
+    int                 res;
+
+    /* Descriptor watches output only while the queue is full */
+    ev.events   = EPOLLOUT;
+    ev.data.ptr = uart;
+    epoll_ctl( uart->epfd, EPOLL_CTL_MOD, uart->fd, &ev );
+
+    do
+        res = epoll_wait( uart->epfd, &ev, 1, HAL_LINUX_TX_WAIT );
+    while( ( res < 0 ) && ( errno == EINTR ) );
+
+    ev.events   = EPOLLIN;
+    ev.data.ptr = uart;
+    epoll_ctl( uart->epfd, EPOLL_CTL_MOD, uart->fd, &ev );
+
+    return ( res > 0 );
+}
+
+static void _hal_flush( T_hal_uartObj *uart )
+{
+    uint16_t    done = 0;
+    ssize_t     res;
+
+    while( done < uart->tx_len )
+    {
+        res = write( uart->fd, &uart->tx_buf[ done ], uart->tx_len - done );
+
+        if( res > 0 )
+            done += res;
+        else if( ( res < 0 ) && ( errno == EAGAIN ) )
+        {
+            if( !_hal_txWait( uart ) )
+                break;
+        }
+        else if( ( res == 0 ) || ( errno != EINTR ) )
+            break;
+    }
+    uart->tx_len = 0;
+}
+
+static void _hal_gpioSet( uint8_t state )
+{
+    ( void )state;
+}
+
+static uint8_t _hal_gpioGet()
+{
+    return 0;
+}
+
+/* -------------------------------------------------------------- HAL UART */
+
+static void hal_uartMap( T_HAL_P uartObj )
+{
+    _hal_uart_cur = ( T_hal_uartObj* )uartObj;
+}
+
+static void hal_uartWrite( uint8_t input )
+{
+    T_hal_uartObj *uart = _hal_uart_cur;
+
+    uart->tx_buf[ uart->tx_len++ ] = input;
+
+    /* Command is complete with the line end */
+    if( ( input == '\n' ) || ( uart->tx_len == HAL_LINUX_BUF_SIZE ) )
+        _hal_flush( uart );
+}
+
+static uint8_t hal_uartRead()
+{
+    return _hal_uart_cur->rx_buf[ _hal_uart_cur->rx_pos++ ];
+}
+
+static uint8_t hal_uartReady()
+{
+    T_hal_uartObj       *uart = _hal_uart_cur;
+    struct epoll_event  ev;
+    ssize_t             res;
+
+    if( uart->rx_pos < uart->rx_len )
+        return 1;
+
+    /* Idle line costs a readiness check, no read */
+    if( epoll_wait( uart->epfd, &ev, 1, 0 ) <= 0 )
+        return 0;
+
+    res = read( uart->fd, uart->rx_buf, HAL_LINUX_BUF_SIZE );
+
+    uart->rx_pos = 0;
+    uart->rx_len = ( res > 0 ) ? res : 0;
+
+    return ( uart->rx_len != 0 );
+}
+
+/* -------------------------------------------------------- PUBLIC FUNCTIONS */
+
+T_HAL_P hal_linuxUartOpen( const char *path, uint32_t baud )
+{
+    T_hal_uartObj       *uart;
+    struct termios      tio;
+    struct epoll_event  ev;
+
+    if( _hal_uart_count >= HAL_LINUX_UART_COUNT )
+        return 0;
+    if( _hal_speed( baud ) == B0 )
+    {
+        errno = EINVAL;
+        return 0;
+    }
+
+    uart = &_hal_uart[ _hal_uart_count ];
+    memset( uart, 0, sizeof( T_hal_uartObj ) );
+
+    uart->fd = open( path, O_RDWR | O_NOCTTY | O_NONBLOCK );
+    if( uart->fd < 0 )
+        return 0;
+
+    /* Raw 8N1, pty ignores the speed */
+    if( !tcgetattr( uart->fd, &tio ) )
+    {
+        cfmakeraw( &tio );
+        cfsetispeed( &tio, _hal_speed( baud ) );
+        cfsetospeed( &tio, _hal_speed( baud ) );
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[ VMIN ]  = 0;
+        tio.c_cc[ VTIME ] = 0;
+        if( tcsetattr( uart->fd, TCSANOW, &tio ) )
+        {
+            close( uart->fd );
+            return 0;
+        }
+        tcflush( uart->fd, TCIOFLUSH );
+    }
+
+    uart->epfd = epoll_create1( 0 );
+    if( uart->epfd < 0 )
+    {
+        close( uart->fd );
+        return 0;
+    }
+    ev.events   = EPOLLIN;
+    ev.data.ptr = uart;
+    epoll_ctl( uart->epfd, EPOLL_CTL_ADD, uart->fd, &ev );
+
+    _hal_uart_count++;
+
+    return ( T_HAL_P )uart;
+}
+
+int hal_linuxUartWait( T_HAL_P uartObj, int timeout_ms )
+{
+    T_hal_uartObj       *uart = ( T_hal_uartObj* )uartObj;
+    struct epoll_event  ev;
+
+    if( uart->rx_pos < uart->rx_len )
+        return 1;
+
+    return epoll_wait( uart->epfd, &ev, 1, timeout_ms );
+}
+
+T_HAL_P hal_linuxGpio()
+{
+    uint8_t i;
+
+    /* Module reset and INT pin are not wired on host adapters */
+    if( !_hal_gpio_f )
+    {
+        for( i = 0; i < 12; i++ )
+        {
+            _hal_gpio.gpioSet[ i ] = _hal_gpioSet;
+            _hal_gpio.gpioGet[ i ] = _hal_gpioGet;
+        }
+        _hal_gpio_f = 1;
+    }
+    return ( T_HAL_P )&_hal_gpio;
+}
+
+/* -------------------------------------------------------------- DELAYS */
+
+static void Delay_100ms()
+{
+    usleep( 100000 );
+}
+
+static void Delay_1sec()
+{
+    usleep( 1000000 );
+}
+
+/* -------------------------------------------------------------------------- */
+/*
+  __HAL_LINUX.c
+
+  Copyright (c) 2017, MikroElektonika - http://www.mikroe.com
+
+  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. All advertising materials mentioning features or use of this software
+   must display the following acknowledgement:
+   This product includes software developed by the MikroElektonika.
+
+4. Neither the name of the MikroElektonika nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY MIKROELEKTRONIKA ''AS IS'' AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL MIKROELEKTRONIKA BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+----------------------------------------------------------------------------- */
@@ -0,0 +1,455 @@
+/*
+    __HAL_SIM.c
+
+-----------------------------------------------------------------------------
+
+  This file is part of mikroSDK.
+
+  Copyright (c) 2017, MikroElektonika - http://www.mikroe.com
+
+  All rights reserved.
+
+----------------------------------------------------------------------------- */
+
+/**
+@file   __HAL_SIM.c
+@brief  Simulated RN2483
+@{
+
+Module simulator placed behind the HAL UART functions. Commands written by the
+driver are parsed and answered after configured delays, so the whole driver
+can be exercised without hardware.
+
+Simulation runs on its own virtual clock ( microseconds ). Every
+hal_uartReady call advances the clock by the configured step, so blocking
+calls progress on their own, hal_simAdvance moves it explicitly. With the
+same configuration and seed a session always produces the same responses.
+
+@}
+*/
+/* -------------------------------------------------------------------------- */
+
+#include <stdint.h>
+
+/* ------------------------------------------------------------------- MACROS */
+
+/**
+ * Number of simulated modules */
+#ifndef HAL_SIM_COUNT
+#define HAL_SIM_COUNT           16
+#endif
+/**
+ * Longest command and response line */
+#define HAL_SIM_LINE_SIZE       560
+/**
+ * Responses waiting for their time - ok and result of a transmission, busy
+ * and the answer to a line cut by the driver */
+#define HAL_SIM_PENDING         4
+
+/* ---------------------------------------------------------------- VARIABLES */
+
+typedef struct
+{
+    uint32_t    due;
+    uint16_t    len;
+    char        text[ HAL_SIM_LINE_SIZE ];
+
+}T_hal_simRsp;
+
+typedef struct
+{
+    T_hal_simCfg    cfg;
+    T_hal_simStats  stats;
+    uint32_t        now;
+    uint32_t        rand;
+    uint8_t         joined;
+
+    /* Command being received */
+    char            cmd[ HAL_SIM_LINE_SIZE ];
+    uint16_t        cmd_len;
+
+    /* Scheduled responses, ordered by time */
+    T_hal_simRsp    rsp[ HAL_SIM_PENDING ];
+    uint8_t         rsp_count;
+
+    /* Response being read by the driver */
+    uint16_t        out_pos;
+
+}T_hal_uartObj;
+
+static T_hal_uartObj    _hal_sim[ HAL_SIM_COUNT ];
+static uint8_t          _hal_sim_count;
+static T_hal_uartObj*   _hal_sim_cur;
+
+static T_hal_gpioObj    _hal_sim_gpio;
+static uint8_t          _hal_sim_gpio_f;
+
+static const char       _HAL_SIM_HEX[ 17 ] = "0123456789ABCDEF";
+
+/* -------------------------------------------- PRIVATE FUNCTION DEFINITIONS */
+
+static uint8_t _hal_simRand( T_hal_uartObj *sim, uint8_t percent )
+{
+    sim->rand = sim->rand * 1103515245UL + 12345UL;
+
+    return ( ( ( sim->rand >> 16 ) % 100 ) < percent );
+}
+
+static uint8_t _hal_simIs( char *cmd, const char *key )
+{
+    while( *key )
+        if( *cmd++ != *key++ )
+            return 0;
+
+    return 1;
+}
+
+static uint16_t _hal_simHexLen( char *hex )
+{
+    uint16_t len = 0;
+
+    while( ( ( hex[ len ] >= '0' ) && ( hex[ len ] <= '9' ) ) ||
+           ( ( ( hex[ len ] | 0x20 ) >= 'a' ) && ( ( hex[ len ] | 0x20 ) <= 'f' ) ) )
+        len++;
+
+    /* Anything after the digits makes payload invalid */
+    if( hex[ len ] || ( len & 1 ) )
+        return 0xFFFF;
+
+    return len;
+}
+
+static void _hal_simPush( T_hal_uartObj *sim, uint32_t delay, const char *text, const char *arg, uint8_t payload )
+{
+    T_hal_simRsp    *rsp;
+    uint32_t        due = sim->now + delay;
+    uint8_t         i;
+
+    if( sim->rsp_count >= HAL_SIM_PENDING )
+    {
+        sim->stats.dropped++;
+        return;
+    }
+
+    /* Immediate answers pass delayed ones, response being read stays first */
+    for( i = sim->rsp_count; ( i > ( sim->out_pos ? 1 : 0 ) ) && ( ( int32_t )( sim->rsp[ i - 1 ].due - due ) > 0 ); i-- )
+        sim->rsp[ i ] = sim->rsp[ i - 1 ];
+
+    sim->rsp_count++;
+    rsp         = &sim->rsp[ i ];
+    rsp->due    = due;
+    rsp->len    = 0;
+
+    while( *text )
+        rsp->text[ rsp->len++ ] = *text++;
+
+    if( arg )
+        while( *arg )
+            rsp->text[ rsp->len++ ] = *arg++;
+
+    /* Pseudo random payload for received frames */
+    for( i = 0; i < payload; i++ )
+    {
+        sim->rand = sim->rand * 1103515245UL + 12345UL;
+        rsp->text[ rsp->len++ ] = _HAL_SIM_HEX[ ( sim->rand >> 16 ) & 0x0F ];
+        rsp->text[ rsp->len++ ] = _HAL_SIM_HEX[ ( sim->rand >> 20 ) & 0x0F ];
+    }
+
+    rsp->text[ rsp->len++ ] = '\r';
+    rsp->text[ rsp->len++ ] = '\n';
+}
+
+static void _hal_simCommand( T_hal_uartObj *sim )
+{
+    T_hal_simCfg    *cfg  = &sim->cfg;
+    char            *cmd  = sim->cmd;
+    char            *arg;
+    uint16_t        len;
+    uint32_t        done;
+    char            port[ 5 ];
+    uint8_t         i;
+
+    sim->stats.commands++;
+
+    /* Second response of the previous command still pending */
+    if( sim->rsp_count &&
+        ( _hal_simIs( cmd, "radio tx " ) || _hal_simIs( cmd, "radio rx " ) ||
+          _hal_simIs( cmd, "mac tx " ) || _hal_simIs( cmd, "mac join " ) ) )
+    {
+        _hal_simPush( sim, cfg->rsp_delay, "busy", 0, 0 );
+        return;
+    }
+
+    if( _hal_simIs( cmd, "sys get ver" ) )
+    {
+        _hal_simPush( sim, cfg->rsp_delay, "RN2483 1.0.1 Dec 15 2015 09:38:09", 0, 0 );
+    }
+    else if( _hal_simIs( cmd, "mac pause" ) )
+    {
+        _hal_simPush( sim, cfg->rsp_delay, "4294967245", 0, 0 );
+    }
+    else if( _hal_simIs( cmd, "radio tx " ) )
+    {
+        len = _hal_simHexLen( &cmd[ 9 ] );
+        if( !len || ( len > 510 ) )
+        {
+            _hal_simPush( sim, cfg->rsp_delay, "invalid_param", 0, 0 );
+            return;
+        }
+        sim->stats.tx_bytes += len / 2;
+        _hal_simPush( sim, cfg->rsp_delay, "ok", 0, 0 );
+        _hal_simPush( sim, cfg->rsp_delay + cfg->airtime,
+                      _hal_simRand( sim, cfg->error_rate ) ? "radio_err" : "radio_tx_ok", 0, 0 );
+    }
+    else if( _hal_simIs( cmd, "radio rxstop" ) )
+    {
+        /* Result of the open window never comes, unless it is being read */
+        if( ( sim->rsp_count > 1 ) || ( sim->rsp_count && !sim->out_pos ) )
+            if( _hal_simIs( sim->rsp[ sim->rsp_count - 1 ].text, "radio_" ) )
+                sim->rsp_count--;
+        _hal_simPush( sim, cfg->rsp_delay, "ok", 0, 0 );
+    }
+    else if( _hal_simIs( cmd, "radio rx " ) )
+    {
+        _hal_simPush( sim, cfg->rsp_delay, "ok", 0, 0 );
+        if( _hal_simRand( sim, cfg->error_rate ) )
+            _hal_simPush( sim, cfg->rsp_delay + cfg->rx_delay, "radio_err", 0, 0 );
+        else
+            _hal_simPush( sim, cfg->rsp_delay + cfg->rx_delay, "radio_rx  ", 0, cfg->rx_size );
+    }
+    else if( _hal_simIs( cmd, "mac tx " ) )
+    {
+        arg = &cmd[ 7 ];
+        if( _hal_simIs( arg, "cnf " ) )
+            arg += 4;
+        else if( _hal_simIs( arg, "uncnf " ) )
+            arg += 6;
+        else
+        {
+            _hal_simPush( sim, cfg->rsp_delay, "invalid_param", 0, 0 );
+            return;
+        }
+
+        /* Port, then payload */
+        for( i = 0; ( *arg >= '0' ) && ( *arg <= '9' ) && ( i < 3 ); i++ )
+            port[ i ] = *arg++;
+        port[ i ]       = ' ';
+        port[ i + 1 ]   = '\0';
+        len = ( *arg == ' ' ) ? _hal_simHexLen( arg + 1 ) : 0xFFFF;
+
+        if( !i || ( len == 0xFFFF ) )
+        {
+            _hal_simPush( sim, cfg->rsp_delay, "invalid_param", 0, 0 );
+            return;
+        }
+        if( !sim->joined )
+        {
+            _hal_simPush( sim, cfg->rsp_delay, "not_joined", 0, 0 );
+            return;
+        }
+        if( _hal_simRand( sim, cfg->error_rate ) )
+        {
+            _hal_simPush( sim, cfg->rsp_delay, "no_free_ch", 0, 0 );
+            return;
+        }
+        sim->stats.tx_bytes += len / 2;
+
+        /* Downlink arrives in the receive window after the uplink */
+        done = cfg->rsp_delay + cfg->airtime + cfg->rx_delay;
+        _hal_simPush( sim, cfg->rsp_delay, "ok", 0, 0 );
+
+        if( _hal_simRand( sim, cfg->error_rate ) )
+            _hal_simPush( sim, done, "mac_err", 0, 0 );
+        else if( _hal_simRand( sim, cfg->downlink_rate ) )
+            _hal_simPush( sim, done, "mac_rx ", port, cfg->rx_size );
+        else
+            _hal_simPush( sim, done, "mac_tx_ok", 0, 0 );
+    }
+    else if( _hal_simIs( cmd, "mac join " ) )
+    {
+        _hal_simPush( sim, cfg->rsp_delay, "ok", 0, 0 );
+
+        if( _hal_simRand( sim, cfg->error_rate ) )
+        {
+            _hal_simPush( sim, cfg->rsp_delay + cfg->airtime + cfg->rx_delay, "denied", 0, 0 );
+        }
+        else
+        {
+            _hal_simPush( sim, cfg->rsp_delay + cfg->airtime + cfg->rx_delay, "accepted", 0, 0 );
+            sim->joined = 1;
+        }
+    }
+    else if( _hal_simIs( cmd, "radio set " ) || _hal_simIs( cmd, "mac set " ) ||
+             _hal_simIs( cmd, "mac resume" ) || _hal_simIs( cmd, "mac reset" ) )
+    {
+        _hal_simPush( sim, cfg->rsp_delay, "ok", 0, 0 );
+    }
+    else
+    {
+        _hal_simPush( sim, cfg->rsp_delay, "invalid_param", 0, 0 );
+    }
+}
+
+static void _hal_simGpioSet( uint8_t state )
+{
+}
+
+static uint8_t _hal_simGpioGet()
+{
+    return 0;
+}
+
+/* -------------------------------------------------------------- HAL UART */
+
+static void hal_uartMap( T_HAL_P uartObj )
+{
+    _hal_sim_cur = ( T_hal_uartObj* )uartObj;
+}
+
+static void hal_uartWrite( uint8_t input )
+{
+    T_hal_uartObj *sim = _hal_sim_cur;
+
+    if( input == '\n' )
+    {
+        sim->cmd[ sim->cmd_len ] = '\0';
+        _hal_simCommand( sim );
+        sim->cmd_len = 0;
+    }
+    else if( ( input != '\r' ) && ( sim->cmd_len < HAL_SIM_LINE_SIZE - 1 ) )
+    {
+        sim->cmd[ sim->cmd_len++ ] = input;
+    }
+}
+
+static uint8_t hal_uartReady()
+{
+    T_hal_uartObj *sim = _hal_sim_cur;
+
+    sim->now += sim->cfg.step;
+
+    return ( sim->rsp_count && ( ( int32_t )( sim->now - sim->rsp[ 0 ].due ) >= 0 ) );
+}
+
+static uint8_t hal_uartRead()
+{
+    T_hal_uartObj   *sim = _hal_sim_cur;
+    T_hal_simRsp    *rsp = &sim->rsp[ 0 ];
+    uint8_t         res  = rsp->text[ sim->out_pos++ ];
+    uint8_t         i;
+
+    /* Response fully read, the rest moves to the front */
+    if( sim->out_pos == rsp->len )
+    {
+        sim->out_pos = 0;
+        sim->stats.responses++;
+        sim->rsp_count--;
+        for( i = 0; i < sim->rsp_count; i++ )
+            sim->rsp[ i ] = sim->rsp[ i + 1 ];
+    }
+    return res;
+}
+
+/* -------------------------------------------------------- PUBLIC FUNCTIONS */
+
+T_HAL_P hal_simOpen( const T_hal_simCfg *cfg )
+{
+    T_hal_uartObj   *sim;
+    uint16_t        i;
+
+    if( _hal_sim_count >= HAL_SIM_COUNT )
+        return 0;
+
+    sim = &_hal_sim[ _hal_sim_count++ ];
+
+    for( i = 0; i < sizeof( T_hal_uartObj ); i++ )
+        ( ( uint8_t* )sim )[ i ] = 0;
+
+    sim->cfg    = *cfg;
+    sim->rand   = cfg->seed;
+
+    return ( T_HAL_P )sim;
+}
+
+void hal_simAdvance( T_HAL_P uartObj, uint32_t time_us )
+{
+    ( ( T_hal_uartObj* )uartObj )->now += time_us;
+}
+
+uint32_t hal_simNow( T_HAL_P uartObj )
+{
+    return ( ( T_hal_uartObj* )uartObj )->now;
+}
+
+void hal_simStats( T_HAL_P uartObj, T_hal_simStats *stats )
+{
+    *stats = ( ( T_hal_uartObj* )uartObj )->stats;
+}
+
+T_HAL_P hal_simGpio()
+{
+    uint8_t i;
+
+    if( !_hal_sim_gpio_f )
+    {
+        for( i = 0; i < 12; i++ )
+        {
+            _hal_sim_gpio.gpioSet[ i ] = _hal_simGpioSet;
+            _hal_sim_gpio.gpioGet[ i ] = _hal_simGpioGet;
+        }
+        _hal_sim_gpio_f = 1;
+    }
+    return ( T_HAL_P )&_hal_sim_gpio;
+}
+
+/* -------------------------------------------------------------- DELAYS */
+
+#ifdef __GNUC__
+/* Module reset needs no waiting, on MCU targets compiler delays are used */
+static void Delay_100ms()
+{
+}
+
+static void Delay_1sec()
+{
+}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/*
+  __HAL_SIM.c
+
+  Copyright (c) 2017, MikroElektonika - http://www.mikroe.com
+
+  All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+3. All advertising materials mentioning features or use of this software
+   must display the following acknowledgement:
+   This product includes software developed by the MikroElektonika.
+
+4. Neither the name of the MikroElektonika nor the
+   names of its contributors may be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY MIKROELEKTRONIKA ''AS IS'' AND ANY
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL MIKROELEKTRONIKA BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+----------------------------------------------------------------------------- */
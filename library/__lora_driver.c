@@ -21,32 +21,118 @@
 /* ------------------------------------------------------------------- MACROS */
 
 /**
- * Timer Limit ( ms ) */
-static const uint16_t LORA_TIMER_EXPIRED =  50000;
+ * Receive Ring Index Mask */
+#define LORA_RX_RING_MASK   ( LORA_RX_RING_SIZE - 1 )
 /**
- * Number of Response Indexes */
-static const uint8_t LORA_RESP_COUNT = 100;
+ * Transmit FIFO Index Mask */
+#define LORA_TX_FIFO_MASK   ( LORA_TX_FIFO_SIZE - 1 )
 /**
- * Response String Max Size */
-static const uint8_t LORA_MAX_RSP_SIZE = 20;
+ * Word at a time hex encoding on 32 bit targets */
+#if defined( __MIKROC_PRO_FOR_ARM__ ) || defined( __MIKROC_PRO_FOR_PIC32__ ) || defined( __MIKROC_PRO_FOR_FT90x__ )
+#define LORA_SWAR_HEX
+#endif
+/**
+ * LoRaWAN overhead of mac tx ( MHDR, FHDR, FPort, MIC ) and join request size */
+#define LORA_AIR_MAC_OVERHEAD    13
+#define LORA_AIR_JOIN_LEN        23
+/**
+ * Payload codec - header flags, LZ window and match length */
+#define LORA_PACK_DELTA         0x40
+#define LORA_PACK_LZ            0x80
+#define LORA_PACK_COUNT_MASK    0x3F
+#define LORA_LZ_WINDOW          32
+#define LORA_LZ_MIN             3
+#define LORA_LZ_MAX             10
+/**
+ * Parity codec - window in the high nibble, index in the low nibble */
+#define LORA_FEC_WINDOW_SHIFT   4
+#define LORA_FEC_INDEX_MASK     0x0F
 /**
- * Command String Max Size */
-static const uint8_t LORA_MAX_CMD_SIZE = 64;
+ * No sub-band is free */
+#define LORA_DC_NO_BAND         0xFF
 /**
- * Data String Max Size */
-static const uint16_t LORA_MAX_DATA_SIZE = 256;
-static const uint16_t LORA_MAX_TRANSFER_SIZE = 384;
+ * Streaming Parser States */
+#define LORA_PAR_KEYWORD    0
+#define LORA_PAR_PORT       1
+#define LORA_PAR_DATA       2
+#define LORA_PAR_TEXT       3
+#define LORA_PAR_NO_NIBBLE  0xFF
+/**
+ * Command Engine States */
+#define LORA_CMD_IDLE       0
+#define LORA_CMD_RSP        1
+#define LORA_CMD_RSP2       2
+
+/**
+ * Response Keywords
+ *
+ * Perfect hash over keyword length, first and last byte. Table is generated
+ * offline, adding a keyword requires new hash constants if it collides. */
+#define LORA_KEYWORD_MAX        31
+#define LORA_KEYWORD_HASH( len, first, last ) \
+    ( ( ( len ) + ( ( uint8_t )( first ) << 4 ) + ( ( uint8_t )( last ) << 1 ) ) & 31 )
+
+typedef struct
+{
+    const char*     key;
+    uint8_t         len;
+    uint8_t         rsp;
+
+}T_lora_keyword;
+
+static const T_lora_keyword _LORA_KEYWORDS[ 32 ] =
+{
+    { "accepted",                           8, LORA_RSP_ACCEPTED },
+    { "radio_tx_ok",                       11, LORA_RSP_RADIO_TX_OK },
+    { "mac_paused",                        10, LORA_RSP_MAC_PAUSED },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { "keys_not_init",                     13, LORA_RSP_KEYS_NOT_INIT },
+    { "mac_rx",                             6, LORA_RSP_MAC_RX },
+    { "frame_counter_err_rejoin_needed",   31, LORA_RSP_FRAME_COUNTER_ERR },
+    { "ok",                                 2, LORA_RSP_OK },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { "radio_err",                          9, LORA_RSP_RADIO_ERR },
+    { "denied",                             6, LORA_RSP_DENIED },
+    { "mac_tx_ok",                          9, LORA_RSP_MAC_TX_OK },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { "not_joined",                        10, LORA_RSP_NOT_JOINED },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { "busy",                               4, LORA_RSP_BUSY },
+    { "invalid_param",                     13, LORA_RSP_INVALID_PARAM },
+    { "radio_rx",                           8, LORA_RSP_RADIO_RX },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { "no_free_ch",                        10, LORA_RSP_NO_FREE_CH },
+    { "mac_err",                            7, LORA_RSP_MAC_ERR },
+    { "invalid_data_len",                  16, LORA_RSP_INVALID_DATA_LEN },
+    { 0,                                    0, LORA_RSP_OTHER },
+    { "silent",                             6, LORA_RSP_SILENT },
+    { 0,                                    0, LORA_RSP_OTHER }
+};
+
+/* Hex Digits */
+static const char _LORA_HEX[ 17 ] = "0123456789ABCDEF";
 
 /* Payload */
 static const char _LORA_PL_CNF[7] = "cnf ";
 static const char _LORA_PL_UNCNF[7] = "uncnf ";
-/* Join mode */
-static const char _LORA_JM_OTAA[5] = "otaa";
-static const char _LORA_JM_ABP[5] = "abp";
+/* Symbol time of SF7 ~ SF12 at 125 kHz ( us ) */
+static const uint16_t _LORA_TSYM[ 6 ] = { 1024, 2048, 4096, 8192, 16384, 32768 };
+#if LORA_USE_DUTY
+/* Duty cycle divisor of each sub-band, time-off = airtime * divisor */
+static const uint16_t _LORA_BAND_DIV[ LORA_BAND_COUNT ] = { 100, 100, 1000, 10, 100 };
+#endif
 
 char LORA_CMD_SYS_GET_VER[] = "sys get ver";
 char LORA_CMD_MAC_PAUSE[] = "mac pause";
 char LORA_CMD_RADIO_SET_WDT[] = "radio set wdt 0";
+char LORA_CMD_RADIO_RXSTOP[] = "radio rxstop";
 char LORA_ARG_0[] = "0";
 
 
@@ -56,507 +142,2461 @@ char LORA_ARG_0[] = "0";
 static uint8_t _slaveAddress;
 #endif
 
-/* Buffers */
-static volatile char            _tx_buffer[ LORA_MAX_TRANSFER_SIZE ];
-static volatile char            _rx_buffer[ LORA_MAX_TRANSFER_SIZE ];
-static volatile uint16_t        _rx_buffer_len;
+/* Empty response handed to callbacks when there is no line */
+static char                     _rx_empty[ 1 ];
 
-/* Timer Flags and Counter */
-static volatile bool            _timer_f;
-static volatile bool            _timeout_f;
-static volatile bool            _timer_use_f;
-static volatile uint32_t        _ticker;
-static volatile uint32_t        _timer_max;
+/* Ends a line cut by timeout, never a valid argument so the module refuses it */
+static char                     _tx_cut[ 4 ] = "~\r\n";
 
-/* Process Flags */
-static volatile bool            _rsp_rdy_f;
-static volatile bool            _lora_rdy_f;
-
-/* Response vars */
-static bool                     _rsp_f;
-static char*                    _rsp_buffer;
-static bool                     _callback_default;
-static void ( *_callback_resp )( char *response );
+/* Context the HAL function pointers are currently mapped to */
+static T_lora_ctx*              _hal_ctx;
 
 /* -------------------------------------------- PRIVATE FUNCTION DECLARATIONS */
 
-static uint8_t  _strlen(const char *s);
-static void     _strcpy(char *dest, const char* src);
-static void     _strcat(char *dest, const char *src);
-static void     _memset(void *s, uint8_t c, size_t n);
-static int8_t   _strcmp(const char* s1, const char* s2);
+static void     _strcpy(char *dest, char* src);
+static void     _memset(uint8_t *s, uint8_t c, size_t n);
+
+static void _lora_hal( T_lora_ctx *ctx );
+static void _lora_cmd_init( T_lora_cmd *cmd, char *prefix, char *arg1, char *arg2, char *arg3, uint8_t rsp_count, uint32_t timeout );
 
-static void _lora_resp();
-static uint8_t _lora_par();
-static uint8_t _lora_repar();
-static void _lora_write();
-static void _lora_read();
+static uint32_t _lora_rx_timeout( char *window_size );
+
+static void _lora_arm( T_lora_ctx *ctx, uint32_t timeout );
+static uint32_t _lora_clock( T_lora_ctx *ctx );
+static uint16_t _lora_hex_bytes( char *hex );
+static void _lora_air_charge( T_lora_ctx *ctx );
+#if LORA_USE_AGG
+static void _lora_agg_send( T_lora_ctx *ctx );
+static void _lora_agg_sent( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len );
+static void _lora_agg_poll( T_lora_ctx *ctx );
+#endif
+#if LORA_USE_FRAG
+static void _lora_frag_next( T_lora_ctx *ctx );
+static void _lora_frag_sent( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len );
+static void _lora_frag_rx( T_lora_ctx *ctx, const uint8_t *data, uint16_t len );
+static void _lora_frag_rx_end( T_lora_ctx *ctx, bool drop_f );
+#endif
+#if LORA_USE_STREAM
+static void _lora_stream_arm( T_lora_ctx *ctx );
+static void _lora_stream_open( T_lora_ctx *ctx );
+static void _lora_stream_done( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len );
+#endif
+#if LORA_USE_BURST
+static void _lora_burst_next( T_lora_ctx *ctx );
+static void _lora_burst_sent( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len );
+#endif
+static uint8_t _lora_varint_put( int32_t value, uint8_t *out );
+static uint8_t _lora_varint_get( const uint8_t *in, uint16_t len, uint16_t *pos, int32_t *value );
+#if LORA_USE_DUTY
+static uint8_t _lora_dc_band( T_lora_ctx *ctx );
+static void _lora_dc_charge( T_lora_ctx *ctx );
+#endif
+static bool _lora_dc_ready( T_lora_ctx *ctx, uint8_t lane );
+static void _lora_deadline( T_lora_ctx *ctx );
+static bool _lora_enqueue( T_lora_ctx *ctx, uint8_t lane, T_lora_cmd *cmd );
+static void _lora_next( T_lora_ctx *ctx );
+static bool _lora_seg_text( T_lora_ctx *ctx, char *text );
+static bool _lora_seg_data( T_lora_ctx *ctx, const uint8_t *data, uint16_t len );
+static bool _lora_build( T_lora_ctx *ctx, T_lora_cmd *cmd );
+static void _lora_u8_str( uint8_t input, char *output );
+static void _lora_complete( T_lora_ctx *ctx, uint8_t status, char *line, uint16_t len );
+static uint8_t _lora_block( T_lora_ctx *ctx, T_lora_cmd *cmd, char *response );
+static void _lora_unblock( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len );
+static uint8_t _lora_classify( char *line, uint16_t len );
+static uint8_t _lora_par( uint8_t rsp );
+static uint8_t _lora_repar( uint8_t rsp );
+static void _lora_write( T_lora_ctx *ctx );
+static void _lora_write_cut( T_lora_ctx *ctx );
+static void _lora_tx_put( T_lora_ctx *ctx, char input );
+static uint16_t _lora_tx_hex( T_lora_ctx *ctx, const uint8_t *data, uint16_t len );
+static void _lora_tx_pump( T_lora_ctx *ctx );
+static void _lora_read( T_lora_ctx *ctx, T_lora_line *line );
+static char* _lora_line_text( T_lora_ctx *ctx, T_lora_line *line );
+static void _lora_rx_drain( T_lora_ctx *ctx );
+static uint8_t _lora_rx_nibble( char input );
+static bool _lora_rx_reserve( T_lora_ctx *ctx );
+static void _lora_rx_frame( T_lora_ctx *ctx, char rx_input );
+static void _lora_rx_line( T_lora_ctx *ctx );
+static void _lora_rx_start( T_lora_ctx *ctx );
+static bool _lora_rx_room( T_lora_ctx *ctx );
+static bool _lora_rx_dispatch( T_lora_ctx *ctx );
 
 
 /* --------------------------------------------- PRIVATE FUNCTION DEFINITIONS */
 
 
-static void _lora_resp()
+static void _strcpy(char *dest, char* src)
 {
-    _rx_buffer_len  = 0;
-    _lora_rdy_f     = false;
-    _rsp_rdy_f      = false;
-    _rsp_f          = true;
+    while( ( *dest++ = *src++ ) );
 }
 
-static uint8_t _strlen(char *s)
+static void _memset(uint8_t *s, uint8_t c, size_t n)
 {
-    char *p = s;
-    while (*s) ++s;
-    return s - p;
+    unsigned char *p = s;
+    while(n--)
+        *p++ = (unsigned char)c;
 }
 
-void _strcpy(char *dest, char* src)
+static void _lora_hal( T_lora_ctx *ctx )
 {
-    char *ret = dest;
-    while (*dest++ = *src++);
-}
+    /* HAL holds one set of function pointers, switch it to this module */
+    if( _hal_ctx == ctx )
+        return;
 
-static void _strcat(char *dest,  char *src)
-{
-    char *ret = dest;
-    while (*dest)
-        dest++;
-    while (*dest++ = *src++);
+#ifdef   __LORA_DRV_SPI__
+    if( ctx->bus )
+        hal_spiMap( ( T_HAL_P )ctx->bus );
+#endif
+#ifdef   __LORA_DRV_I2C__
+    if( ctx->bus )
+        hal_i2cMap( ( T_HAL_P )ctx->bus );
+#endif
+#ifdef   __LORA_DRV_UART__
+    if( ctx->bus )
+        hal_uartMap( ( T_HAL_P )ctx->bus );
+#endif
+    hal_gpioMap( ( T_HAL_P )ctx->gpio );
+    _hal_ctx = ctx;
 }
-static void _strncpy(uint8_t *dest, uint8_t *src, uint16_t count)
+
+static uint8_t _lora_classify( char *line, uint16_t kw_len )
 {
-    char *tmp  = dest;
+    const T_lora_keyword    *kw;
+    uint8_t                 i;
 
-    uint16_t i = 0;
+    if( !kw_len || ( kw_len > LORA_KEYWORD_MAX ) )
+        return LORA_RSP_OTHER;
 
-    while (0 != count)
-    {
-        if (0 != (*tmp = src[i]))
-        {
-            i++;
-        }
-        tmp++;
-        count--;
-    }
-}
+    kw = &_LORA_KEYWORDS[ LORA_KEYWORD_HASH( kw_len, line[ 0 ], line[ kw_len - 1 ] ) ];
 
-/*void _xtoi(char* origin, uint8_t* result)
-{
-    uint8_t szlen = _strlen(origin);
-    uint8_t idx, ptr, factor;
+    if( kw->len != kw_len )
+        return LORA_RSP_OTHER;
 
-    if(szlen > 0)
-    {
-         *result = 0;
-         factor = 1;
+    /* First and last byte already matched by the hash */
+    for( i = 1; i < kw_len - 1; i++ )
+        if( line[ i ] != kw->key[ i ] )
+            return LORA_RSP_OTHER;
 
-         for(idx = szlen-1; idx >= 0; --idx)
-         {
-               if(isxdigit( *(origin+idx)))
-               {
-                    if( *(origin + idx) >= 97)
-                         ptr = ( *(origin + idx) - 97) + 10;
-                    else if( *(origin + idx) >= 65)
-                         ptr = ( *(origin + idx) - 65) + 10;
-                    else
-                         ptr = *(origin + idx) - 48;
-                    *result += (ptr * factor);
-                    factor *= 16;
-                }
+    return kw->rsp;
+}
 
-          }
-     }
-}*/
+static uint8_t _lora_par( uint8_t rsp )
+{
+    /* First response reports only command errors */
+    if( ( rsp >= LORA_RSP_INVALID_PARAM ) && ( rsp <= LORA_RSP_KEYS_NOT_INIT ) )
+        return rsp;
 
-static void _memset(uint8_t *s, uint8_t c, size_t n)
+    return LORA_RSP_OK;
+}
+
+static uint8_t _lora_repar( uint8_t rsp )
 {
-    unsigned char *p = s;
-    while(n--)
-        *p++ = (unsigned char)c;
+    switch( rsp )
+    {
+        case LORA_RSP_MAC_ERR:
+        case LORA_RSP_MAC_RX:
+        case LORA_RSP_RADIO_ERR:
+        case LORA_RSP_DENIED:
+            return rsp;
+        case LORA_RSP_INVALID_DATA_LEN:
+            return LORA_RSP_TX_INVALID_DATA_LEN;
+    }
+    return LORA_RSP_OK;
 }
 
-static int8_t _strcmp(char* s1, char* s2)
+static void _lora_cmd_init( T_lora_cmd *cmd, char *prefix, char *arg1, char *arg2, char *arg3, uint8_t rsp_count, uint32_t timeout )
 {
-    while(*s1 && (*s1==*s2))
-        s1++,s2++;
-    return *( unsigned char*)s1-*( unsigned char*)s2;
+    cmd->prefix     = prefix;
+    cmd->arg1       = arg1;
+    cmd->arg2       = arg2;
+    cmd->arg3       = arg3;
+    cmd->data       = 0;
+    cmd->data_len   = 0;
+    cmd->port       = 0;
+    cmd->response   = 0;
+    cmd->downlink   = 0;
+    cmd->done       = 0;
+    cmd->rsp_count  = rsp_count;
+    cmd->timeout    = timeout;
+    cmd->air_len    = 0;
+    cmd->head_len   = 0;
 }
 
+static uint32_t _lora_rx_timeout( char *window_size )
+{
+    /* Window 0 keeps the receiver on until something arrives */
+    if( ( window_size[ 0 ] == '0' ) && !window_size[ 1 ] )
+        return 0;
 
+    return LORA_TIMEOUT_RADIO;
+}
 
-static uint8_t _lora_par()
+static void _lora_arm( T_lora_ctx *ctx, uint32_t timeout )
 {
-    if( !_strcmp( _rx_buffer, "invalid_param" ) )
-        return 1;
-    if( !_strcmp( _rx_buffer, "not_joined" ) )
-        return 2;
-    if( !_strcmp( _rx_buffer, "no_free_ch" ) )
-        return 3;
-    if( !_strcmp( _rx_buffer, "silent" ) )
-        return 4;
-    if( !_strcmp( _rx_buffer, "frame_counter_err_rejoin_needed" ) )
-        return 5;
-    if( !_strcmp( _rx_buffer, "busy" ) )
-        return 6;
-    if( !_strcmp( _rx_buffer, "mac_paused" ) )
-        return 7;
-    if( !_strcmp( _rx_buffer, "invalid_data_len" ) )
-        return 8;
-    if( !_strcmp( _rx_buffer, "keys_not_init" ) )
-        return 9;
-    return 0;
+    ctx->timer_f        = false;
+    ctx->timeout_f      = false;
+    ctx->deadline       = _lora_clock( ctx ) + timeout;
+    ctx->timer_f        = ( timeout != 0 );
 }
-static uint8_t _lora_repar()
+
+static uint32_t _lora_clock( T_lora_ctx *ctx )
 {
-    if( !_strcmp( _rx_buffer, "mac_err" ) )
-        return 10;
-    if( !_strcmp( _rx_buffer, "mac_tx_ok" ) )
-        return 0;
-    if( !_strcmp( _rx_buffer, "mac_rx" ) )
-        return 12;
-    if( !_strcmp( _rx_buffer, "invalid_data_len" ) )
-        return 13;
-    if( !_strcmp( _rx_buffer, "radio_err" ) )
-        return 14;
-    if( !_strcmp( _rx_buffer, "radio_tx_ok" ) )
-        return 0;
-    if( !_strcmp( _rx_buffer, "radio_rx" ) )
-        return 0;
-    if( !_strcmp( _rx_buffer, "accepted" ) )
-        return 0;
-    if( !_strcmp( _rx_buffer, "denied" ) )
-        return 18;
-    return 0;
+    if( ctx->now )
+        ctx->clock = ctx->now();
+
+    return ctx->clock;
 }
 
-static void _lora_write()
+static uint16_t _lora_hex_bytes( char *hex )
 {
-    char *ptr = _tx_buffer;
+    uint16_t len = 0;
 
-    while( *ptr )
-        if( !hal_gpio_intGet() )
-            hal_uartWrite( *ptr++ );
+    while( hex[ len ] )
+        len++;
 
-    hal_uartWrite( '\r' );
-    hal_uartWrite( '\n' );
-
-    _rx_buffer_len  = 0;
-    _lora_rdy_f     = false;
-    _rsp_rdy_f      = false;
-    _timer_f        = true;
-    _rsp_f          = true;
+    return len / 2;
 }
 
-static void _lora_read()
+static void _lora_air_charge( T_lora_ctx *ctx )
 {
-    if( !_rsp_f )
-    {
-        hal_gpio_csSet( true );
-        _callback_resp( _rx_buffer );
-        hal_gpio_csSet( false );
+    uint32_t toa = lora_toa( ctx->air_sf, ctx->air_bw, ctx->air_cr, ctx->air_len );
 
-    } 
-    else if( _rsp_f )
+    /* Budget window restarts once the period is over */
+    if( ctx->air_period && ( ( uint32_t )( _lora_clock( ctx ) - ctx->air_start ) >= ctx->air_period ) )
     {
-        hal_gpio_csSet( true );
-        _strcpy( _rsp_buffer, _rx_buffer );
-        hal_gpio_csSet( false );
+        ctx->air_start  = ctx->clock;
+        ctx->air_used   = 0;
     }
-
-    _lora_rdy_f     = true;
-    _rsp_rdy_f      = false;
-    _timer_f        = false;
-    _rsp_f          = true;
+    ctx->air_used   += toa;
+    ctx->air_total  += toa;
+    ctx->air_frames++;
 }
 
-
-/* --------------------------------------------------------- PUBLIC FUNCTIONS */
-
-#ifdef   __LORA_DRV_SPI__
-
-void lora_spiDriverInit(T_LORA_P gpioObj, T_LORA_P spiObj)
+#if LORA_USE_DUTY
+static uint8_t _lora_dc_band( T_lora_ctx *ctx )
 {
-    hal_spiMap( (T_HAL_P)spiObj );
-    hal_gpioMap( (T_HAL_P)gpioObj );
+    uint32_t    now = _lora_clock( ctx );
+    uint8_t     i;
 
-    // ... power ON
-    // ... configure CHIP
-}
+    for( i = 0; i < LORA_BAND_COUNT; i++ )
+        if( ( ctx->dc_mask & ( 1 << i ) ) && ( ( int32_t )( now - ctx->dc_free[ i ] ) >= 0 ) )
+            return i;
 
+    return LORA_DC_NO_BAND;
+}
 #endif
-#ifdef   __LORA_DRV_I2C__
 
-void lora_i2cDriverInit(T_LORA_P gpioObj, T_LORA_P i2cObj, uint8_t slave)
+static bool _lora_dc_ready( T_lora_ctx *ctx, uint8_t lane )
 {
-    _slaveAddress = slave;
-    hal_i2cMap( (T_HAL_P)i2cObj );
-    hal_gpioMap( (T_HAL_P)gpioObj );
+#if LORA_USE_DUTY
+    T_lora_cmd *cmd;
+#endif
 
-    // ... power ON
-    // ... configure CHIP
-}
+    if( ctx->cmd_head[ lane ] == ctx->cmd_tail[ lane ] )
+        return false;
+
+#if LORA_USE_DUTY
+    cmd = &ctx->cmd_queue[ lane ][ ctx->cmd_tail[ lane ] % LORA_CMD_QUEUE_SIZE ];
 
+    return !ctx->dc_mask || !cmd->air_len || ( _lora_dc_band( ctx ) != LORA_DC_NO_BAND );
+#else
+    return true;
 #endif
-#ifdef   __LORA_DRV_UART__
+}
 
-void lora_uartDriverInit(T_LORA_P gpioObj, T_LORA_P uartObj)
+#if LORA_USE_DUTY
+static void _lora_dc_charge( T_lora_ctx *ctx )
 {
-    hal_uartMap( (T_HAL_P)uartObj );
-    hal_gpioMap( (T_HAL_P)gpioObj );
+    uint8_t band = _lora_dc_band( ctx );
 
-    // ... power ON
-    // ... configure CHIP
+    if( band != LORA_DC_NO_BAND )
+        ctx->dc_free[ band ] = ctx->clock + lora_toa( ctx->air_sf, ctx->air_bw, ctx->air_cr, ctx->air_len ) * _LORA_BAND_DIV[ band ];
 }
-
 #endif
 
-// GPIO Only Drivers - remove in other cases
-void lora_gpioDriverInit(T_LORA_P gpioObj)
+#if LORA_USE_AGG
+static void _lora_agg_send( T_lora_ctx *ctx )
 {
-    hal_gpioMap( (T_HAL_P)gpioObj );
+    uint8_t fill = ctx->agg_fill;
 
-    // ... power ON
-}
+    if( !ctx->agg_flush_f || ctx->agg_send_f || !ctx->agg_len[ fill ] )
+        return;
 
-/* ----------------------------------------------------------- IMPLEMENTATION */
-/******************************************************************************
-*  LoRa INIT
-*******************************************************************************/
+    /* Queue full - frame stays pending and is retried from lora_process */
+    if( !lora_mac_tx_bin_async( ctx, ctx->agg_port, ctx->agg_buf[ fill ], ctx->agg_len[ fill ],
+                                ctx->agg_confirmed, 0, ctx->agg_lane, _lora_agg_sent ) )
+        return;
 
-void lora_init(bool CB_default, void ( *response_p )( char *response ))
+    ctx->agg_send_f     = true;
+    ctx->agg_flush_f    = false;
+    ctx->agg_lane       = LORA_LANE_NORMAL;
+    ctx->agg_fill       = fill ^ 1;
+    ctx->agg_len[ fill ^ 1 ] = 0;
+}
+
+static void _lora_agg_sent( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
 {
-    hal_gpio_rstSet( 1 );
-    Delay_100ms();
-    hal_gpio_rstSet( 0 );
-    Delay_100ms();
-    Delay_100ms();
-    Delay_100ms();
-    hal_gpio_rstSet( 1 );
-    Delay_100ms();
-    hal_gpio_csSet( 1 );
-    
-    _memset( _tx_buffer, 0, LORA_MAX_CMD_SIZE + LORA_MAX_DATA_SIZE );
-    _memset( _rx_buffer, 0, LORA_MAX_RSP_SIZE + LORA_MAX_DATA_SIZE );
-    
-    _timer_max          = LORA_TIMER_EXPIRED;
-    _rx_buffer_len      = 0;
-    _ticker             = 0;
-    _timer_f            = false;
-    _timeout_f          = false;
-    _timer_use_f        = false;
-    _rsp_f              = false;
-    _rsp_rdy_f          = false;
-    _lora_rdy_f         = true;
-    _callback_resp      = response_p;
-    _callback_default   = CB_default;
-    
-    Delay_1sec();
+    ctx->agg_send_f = false;
+
+    if( ctx->agg_done )
+        ctx->agg_done( ctx, status, response, len );
 }
-/******************************************************************************
-*  LoRa CMD
-*******************************************************************************/
-void lora_cmd(char *cmd,  char *response)
+
+static void _lora_agg_poll( T_lora_ctx *ctx )
 {
-    char buf[] = "";
-    uint8_t *pom = buf;
-    while( !_lora_rdy_f )
-        lora_process();
+    if( !ctx->agg_port || !ctx->agg_len[ ctx->agg_fill ] )
+        return;
 
-    _strcpy( _tx_buffer, cmd );
+    if( ctx->agg_age && ( ( uint32_t )( _lora_clock( ctx ) - ctx->agg_first ) >= ctx->agg_age ) )
+        ctx->agg_flush_f = true;
 
-    _rsp_buffer = response;
-    _lora_write();
+    _lora_agg_send( ctx );
+}
+#endif
 
-    while( !_lora_rdy_f )
-        lora_process();
+#if LORA_USE_FRAG
+static void _lora_frag_next( T_lora_ctx *ctx )
+{
+    T_lora_cmd  tmp;
+    uint16_t    offset;
+    uint16_t    len;
+
+    if( !ctx->frag_send_f )
+        return;
+
+    offset  = ( uint16_t )ctx->frag_index * ctx->frag_size;
+    len     = ctx->frag_len - offset;
+    if( len > ctx->frag_size )
+        len = ctx->frag_size;
+
+    _lora_cmd_init( &tmp, LORA_MAC_TX, ( char* )( ctx->frag_confirmed ? _LORA_PL_CNF : _LORA_PL_UNCNF ), 0, 0, 2, LORA_TIMEOUT_MAC );
+    tmp.port        = ctx->frag_port;
+    tmp.head[ 0 ]   = ctx->frag_id;
+    tmp.head[ 1 ]   = ctx->frag_index;
+    tmp.head[ 2 ]   = ctx->frag_count;
+    tmp.head_len    = LORA_FRAG_HDR;
+    tmp.data        = ctx->frag_data + offset;
+    tmp.data_len    = len;
+    tmp.air_len     = LORA_AIR_MAC_OVERHEAD + LORA_FRAG_HDR + len;
+    tmp.done        = _lora_frag_sent;
+
+    /* Queue full - fragment is retried from lora_process */
+    if( _lora_enqueue( ctx, LORA_LANE_NORMAL, &tmp ) )
+        ctx->frag_send_f = false;
 }
-/******************************************************************************
-* LoRa MAC TX
-*******************************************************************************/
-uint8_t lora_mac_tx(char* payload, char* port_no, char *buffer, char *response)
+
+static void _lora_frag_sent( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
 {
-    uint8_t res   = 0;
+    if( ( !status || ( status == LORA_RSP_MAC_RX ) ) && ( ++ctx->frag_index < ctx->frag_count ) )
+    {
+        ctx->frag_send_f = true;
+        _lora_frag_next( ctx );
+        return;
+    }
 
-    while( !_lora_rdy_f )
-        lora_process();
+    ctx->frag_data = 0;
+    if( ctx->frag_done )
+        ctx->frag_done( ctx, status, response, len );
+}
 
-    _strcpy( _tx_buffer, ( char* )LORA_MAC_TX );
-    _strcat( _tx_buffer, payload);
-    _strcat( _tx_buffer, port_no );
-    _strcat( _tx_buffer, " " );
-    _strcat( _tx_buffer, buffer );
-    _rsp_buffer = response;
-    _lora_write();
+static void _lora_frag_rx( T_lora_ctx *ctx, const uint8_t *data, uint16_t len )
+{
+    uint8_t     id;
+    uint8_t     index;
+    uint8_t     count;
+    uint8_t     bit;
+    uint16_t    offset;
+    uint16_t    park;
+    uint16_t    i;
+
+    if( len < LORA_FRAG_HDR )
+        return;
+
+    id      = data[ 0 ];
+    index   = data[ 1 ];
+    count   = data[ 2 ];
+    data   += LORA_FRAG_HDR;
+    len    -= LORA_FRAG_HDR;
+
+    if( !count || ( count > LORA_FRAG_MAX ) || ( index >= count ) )
+        return;
+
+    /* Late repeat of a finished blob must not start it again */
+    if( ( !ctx->frag_rx_count || ( id != ctx->frag_rx_id ) ) && ctx->frag_rx_last_f && ( id == ctx->frag_rx_last ) )
+    {
+        ctx->frag_rx_stats.ignored++;
+        return;
+    }
 
-    while( !_lora_rdy_f )
-        lora_process();
+    /* New blob drops the incomplete one */
+    if( !ctx->frag_rx_count || ( id != ctx->frag_rx_id ) || ( count != ctx->frag_rx_count ) )
+    {
+        if( ctx->frag_rx_count && ctx->frag_rx_got )
+            ctx->frag_rx_stats.dropped++;
+        ctx->frag_rx_id     = id;
+        ctx->frag_rx_count  = count;
+        ctx->frag_rx_got    = 0;
+        ctx->frag_rx_fsize  = 0;
+        ctx->frag_rx_total  = 0;
+        ctx->frag_rx_tail   = 0;
+        _memset( ctx->frag_rx_map, 0, sizeof( ctx->frag_rx_map ) );
+    }
 
-    if( ( res = _lora_par() ) )
-        return res;
+    bit = 1 << ( index & 7 );
+    if( ctx->frag_rx_map[ index >> 3 ] & bit )
+        return;
 
-    _lora_resp();
+    /* Every fragment but the last one carries the fragment size */
+    if( index + 1 < count )
+    {
+        if( !ctx->frag_rx_fsize )
+        {
+            if( ctx->frag_rx_tail )
+            {
+                /* Parked last fragment moves down to its place */
+                offset = ( uint16_t )( count - 1 ) * len;
+                if( ( uint32_t )offset + ctx->frag_rx_tail > ctx->frag_rx_size )
+                {
+                    _lora_frag_rx_end( ctx, true );
+                    return;
+                }
+                park = ctx->frag_rx_size - ctx->frag_rx_tail;
+                for( i = 0; i < ctx->frag_rx_tail; i++ )
+                    ctx->frag_rx_buf[ offset + i ] = ctx->frag_rx_buf[ park + i ];
+                ctx->frag_rx_total = offset + ctx->frag_rx_tail;
+                ctx->frag_rx_tail  = 0;
+            }
+            ctx->frag_rx_fsize = len;
+        }
+        else if( len != ctx->frag_rx_fsize )
+            return;
+    }
+    else if( !ctx->frag_rx_fsize && ( count > 1 ) )
+    {
+        /* Last fragment came first, its offset is known with the size of
+           the others - it waits at the buffer end, above all of them */
+        if( !len )
+            return;
+        if( len > ctx->frag_rx_size )
+        {
+            _lora_frag_rx_end( ctx, true );
+            return;
+        }
+        park = ctx->frag_rx_size - len;
+        for( i = 0; i < len; i++ )
+            ctx->frag_rx_buf[ park + i ] = data[ i ];
+        ctx->frag_rx_tail = len;
+        ctx->frag_rx_map[ index >> 3 ] |= bit;
+        ctx->frag_rx_got++;
+        return;
+    }
 
-    do 
+    offset = ( uint16_t )index * ctx->frag_rx_fsize;
+    if( ( uint32_t )offset + len > ctx->frag_rx_size )
     {
-        while( !_lora_rdy_f )
-            lora_process();
+        _lora_frag_rx_end( ctx, true );
+        return;
+    }
+
+    for( i = 0; i < len; i++ )
+        ctx->frag_rx_buf[ offset + i ] = data[ i ];
 
-    } while( ( res = _lora_repar() ) == 12 );
+    ctx->frag_rx_map[ index >> 3 ] |= bit;
+    ctx->frag_rx_got++;
+    if( index + 1 == count )
+        ctx->frag_rx_total = offset + len;
 
-    return res;
+    if( ctx->frag_rx_got == count )
+        _lora_frag_rx_end( ctx, false );
 }
-/******************************************************************************
-*  LoRa JOIN
-*******************************************************************************/
-uint8_t lora_join(char* join_mode, char *response)
+
+static void _lora_frag_rx_end( T_lora_ctx *ctx, bool drop_f )
 {
-    uint8_t res = 0;
+    /* Blob that can never complete is given up, the rest of it is ignored */
+    ctx->frag_rx_count  = 0;
+    ctx->frag_rx_last   = ctx->frag_rx_id;
+    ctx->frag_rx_last_f = true;
 
-    while( !_lora_rdy_f )
-        lora_process();
+    if( drop_f )
+    {
+        ctx->frag_rx_stats.dropped++;
+        return;
+    }
 
-    _strcpy( _tx_buffer, ( char* )LORA_JOIN );
-    _strcat( _tx_buffer, join_mode );
-    _rsp_buffer = response;
-    _lora_write();
+    ctx->frag_rx_stats.blobs++;
+    if( ctx->frag_rx_done )
+        ctx->frag_rx_done( ctx, ctx->frag_rx_buf, ctx->frag_rx_total );
+}
+#endif
 
-    while( !_lora_rdy_f )
-        lora_process();
+#if LORA_USE_STREAM
+static void _lora_stream_arm( T_lora_ctx *ctx )
+{
+    T_lora_cmd tmp;
 
-    if( ( res = _lora_par() ) )
-        return res;
+    /* Receiver is switched off before anything else goes out */
+    if( ctx->stream_stop_f )
+    {
+        _lora_cmd_init( &tmp, LORA_CMD_RADIO_RXSTOP, 0, 0, 0, 1, LORA_TIMEOUT_CMD );
+        if( _lora_enqueue( ctx, LORA_LANE_URGENT, &tmp ) )
+            ctx->stream_stop_f = false;
+    }
 
-    _lora_resp();
+    if( !ctx->stream_arm_f )
+        return;
 
-    while( !_lora_rdy_f )
-        lora_process();
+    _lora_cmd_init( &tmp, LORA_RADIO_RX, LORA_ARG_0, 0, 0, 2, _lora_rx_timeout( LORA_ARG_0 ) );
+    tmp.downlink    = ctx->stream_downlink;
+    tmp.done        = _lora_stream_done;
 
-    return _lora_repar();
+    /* Queue full - window is re-armed from lora_process */
+    if( _lora_enqueue( ctx, LORA_LANE_NORMAL, &tmp ) )
+        ctx->stream_arm_f = false;
 }
-/******************************************************************************
-* LORA RX
-*******************************************************************************/
-uint8_t lora_rx(char* window_size, char *response)
+
+static void _lora_stream_open( T_lora_ctx *ctx )
 {
-    uint8_t res = 0;
+    T_lora_streamStats  *stats = &ctx->stream_stats;
+    uint32_t            gap;
+
+    ctx->stream_open_f = true;
+    stats->windows++;
 
-    while( !_lora_rdy_f )
-        lora_process();
+    if( !ctx->stream_end_f )
+        return;
 
-    _strcpy( _tx_buffer, "radio rx " );
-    _strcat( _tx_buffer, window_size );
-    _rsp_buffer = response;
-    _lora_write();
+    gap = _lora_clock( ctx ) - ctx->stream_end;
+    stats->gap_last   = gap;
+    stats->gap_total += gap;
+    if( gap > stats->gap_max )
+        stats->gap_max = gap;
+}
 
-   while( !_lora_rdy_f )
-        lora_process();
+static void _lora_stream_done( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
+{
+    bool open_f = ctx->stream_open_f;
 
-    if(res = _lora_par())
-        return res;
+    ctx->stream_open_f  = false;
+    ctx->stream_end     = _lora_clock( ctx );
+    ctx->stream_end_f   = true;
 
-    _lora_resp();
+    if( !open_f )
+        ctx->stream_f = false;
+    else if( !status )
+        ctx->stream_stats.frames++;
+    else if( status != LORA_RSP_ABORTED )
+        ctx->stream_stats.errors++;
 
-    while( !_lora_rdy_f )
-        lora_process();
+    if( ctx->stream_done )
+        ctx->stream_done( ctx, status, response, len );
 
-    return _lora_repar();
+    /* Queued behind anything the callback has just sent */
+    if( ctx->stream_f )
+    {
+        ctx->stream_arm_f = true;
+        _lora_stream_arm( ctx );
+    }
 }
-/******************************************************************************
-* LORA TX
-*******************************************************************************/
-uint8_t lora_tx( char *buffer )
+#endif
+
+#if LORA_USE_BURST
+static void _lora_burst_next( T_lora_ctx *ctx )
 {
-    uint8_t res = 0;
-    
-    lora_process();
-    _strcpy( _tx_buffer, "radio tx ");
-    _strcat( _tx_buffer, buffer );
+    T_lora_cmd          tmp;
+    const T_lora_frame  *frame;
 
-    _lora_write();
+    if( !ctx->burst_send_f )
+        return;
 
+    frame = &ctx->burst_frames[ ctx->burst_index ];
 
-        lora_process();
+    _lora_cmd_init( &tmp, LORA_RADIO_TX, 0, 0, 0, 2, LORA_TIMEOUT_RADIO );
+    tmp.data        = frame->data;
+    tmp.data_len    = frame->len;
+    tmp.air_len     = frame->len;
+    tmp.done        = _lora_burst_sent;
 
-    if( ( res = _lora_par() ) )
-        return res;
+    /* Queue full - frame is retried from lora_process */
+    if( _lora_enqueue( ctx, ctx->burst_lane, &tmp ) )
+    {
+        ctx->burst_send_f = false;
+        ctx->burst_queued = _lora_clock( ctx );
+    }
+}
+
+static void _lora_burst_sent( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
+{
+    T_lora_burstStats   *stats = &ctx->burst_stats;
+    uint32_t            clock = _lora_clock( ctx );
+    uint32_t            lat;
 
-    _lora_resp();
-    lora_process();
+    if( !status )
+    {
+        lat = clock - ctx->burst_queued;
+        stats->frames++;
+        stats->elapsed    = clock - ctx->burst_start;
+        stats->lat_last   = lat;
+        stats->lat_total += lat;
+        if( lat > stats->lat_max )
+            stats->lat_max = lat;
+
+        if( ++ctx->burst_index < ctx->burst_count )
+        {
+            ctx->burst_send_f = true;
+            _lora_burst_next( ctx );
+            return;
+        }
+    }
 
-    return _lora_repar();
+    ctx->burst_frames = 0;
+    if( ctx->burst_done )
+        ctx->burst_done( ctx, status, response, len );
 }
-/******************************************************************************
-* LORA RX ISR
-*******************************************************************************/
-void lora_rx_isr( char rx_input )
+#endif
+
+static uint8_t _lora_varint_put( int32_t value, uint8_t *out )
 {
-    static bool _rx_sentence_f;
+    /* Zigzag - small negative numbers become small positive */
+    uint32_t    tmp = ( value < 0 ) ? ~( ( uint32_t )value << 1 ) : ( ( uint32_t )value << 1 );
+    uint8_t     len = 0;
 
-    _rx_buffer[ _rx_buffer_len++ ] = rx_input;
-     if ( rx_input == '\r' )
+    while( tmp >= 0x80 )
     {
-        _rx_buffer[ _rx_buffer_len++ ] = '\0';
-        _rsp_rdy_f = true;  
-    } 
+        out[ len++ ] = ( uint8_t )tmp | 0x80;
+        tmp >>= 7;
+    }
+    out[ len++ ] = ( uint8_t )tmp;
+
+    return len;
 }
-/******************************************************************************
-* LORA TICK ISR
-*******************************************************************************/
-void lora_tick_isr()
+
+static uint8_t _lora_varint_get( const uint8_t *in, uint16_t len, uint16_t *pos, int32_t *value )
 {
-    if( _timer_use_f )
-        if( _timer_f && ( _ticker++ > _timer_max ) )
-            _timeout_f = true;
+    uint32_t    tmp   = 0;
+    uint8_t     shift = 0;
+    uint8_t     byte;
+
+    do
+    {
+        if( ( *pos >= len ) || ( shift > 28 ) )
+            return 0;
+
+        byte  = in[ ( *pos )++ ];
+        tmp  |= ( uint32_t )( byte & 0x7F ) << shift;
+        shift += 7;
+    }
+    while( byte & 0x80 );
+
+    *value = ( tmp & 1 ) ? ( int32_t )~( tmp >> 1 ) : ( int32_t )( tmp >> 1 );
+
+    return 1;
 }
-/******************************************************************************
-* LoRa TICK CONF
-*******************************************************************************/
-void lora_tick_conf( uint32_t timer_limit )
+
+static void _lora_deadline( T_lora_ctx *ctx )
 {
-    if ( timer_limit )
+    /* Deadline of the command in flight, fires once */
+    if( ctx->timer_use_f && ctx->timer_f && ( ( int32_t )( ctx->clock - ctx->deadline ) >= 0 ) )
     {
-        _timer_max = timer_limit;
-        _timer_use_f = true;
-    } 
-    else 
+        ctx->timer_f    = false;
+        ctx->timeout_f  = true;
+    }
+}
+
+static bool _lora_enqueue( T_lora_ctx *ctx, uint8_t lane, T_lora_cmd *cmd )
+{
+    T_lora_queueStats   *stats = &ctx->cmd_stats[ lane ];
+    uint8_t             depth  = ctx->cmd_head[ lane ] - ctx->cmd_tail[ lane ];
+
+    if( depth >= LORA_CMD_QUEUE_SIZE )
     {
-        _timer_max = LORA_TIMER_EXPIRED;
-        _timer_use_f = false;
+        stats->rejected++;
+        return false;
     }
+
+    cmd->queued = _lora_clock( ctx );
+    ctx->cmd_queue[ lane ][ ctx->cmd_head[ lane ] % LORA_CMD_QUEUE_SIZE ] = *cmd;
+    ctx->cmd_head[ lane ]++;
+
+    if( ++depth > stats->max_depth )
+        stats->max_depth = depth;
+
+    return true;
 }
-/******************************************************************************
-*  LoRa PROCESS
-*******************************************************************************/
-void lora_process()
+
+static void _lora_next( T_lora_ctx *ctx )
 {
-    if (hal_uartReady())
+    T_lora_cmd          *cmd;
+    T_lora_queueStats   *stats;
+    uint32_t            wait;
+    uint8_t             lane = LORA_LANE_URGENT;
+
+    /* Uplinks waiting for a free sub-band do not hold the other lane */
+    if( !_lora_dc_ready( ctx, lane ) )
+        lane = LORA_LANE_NORMAL;
+    if( !_lora_dc_ready( ctx, lane ) )
+        return;
+
+    cmd     = &ctx->cmd_queue[ lane ][ ctx->cmd_tail[ lane ] % LORA_CMD_QUEUE_SIZE ];
+    stats   = &ctx->cmd_stats[ lane ];
+    wait    = _lora_clock( ctx ) - cmd->queued;
+
+    stats->dispatched++;
+    stats->wait_total += wait;
+    if( wait > stats->wait_max )
+        stats->wait_max = wait;
+
+    ctx->cmd_rsp_count  = cmd->rsp_count;
+    ctx->cmd_done       = cmd->done;
+    ctx->rsp_buffer     = cmd->response;
+    ctx->rsp_downlink   = cmd->downlink;
+    ctx->air_len        = cmd->air_len;
+    ctx->cmd_state      = LORA_CMD_RSP;
+    ctx->cmd_tail[ lane ]++;
+
+    if( ctx->rsp_downlink )
     {
-        char tmp = hal_uartRead();
-        lora_rx_isr( tmp );
+        ctx->rsp_downlink->port = 0;
+        ctx->rsp_downlink->data = 0;
+        ctx->rsp_downlink->len  = 0;
     }
-    if ( _rsp_rdy_f )
-    {        
-        _lora_read();
+
+#if LORA_USE_STREAM
+    /* Window queued before the stream was stopped is not opened */
+    if( ( ctx->cmd_done == _lora_stream_done ) && !ctx->stream_f )
+    {
+        _lora_complete( ctx, LORA_RSP_ABORTED, _rx_empty, 0 );
+        return;
     }
-    if ( _timeout_f )
+#endif
+
+    if( !_lora_build( ctx, cmd ) )
     {
-        _lora_read();
+        /* Nothing of a command that does not fit is written */
+        ctx->tx_seg_count = 0;
+        _lora_complete( ctx, LORA_RSP_OVERFLOW, _rx_empty, 0 );
+        return;
     }
+
+    _lora_tx_pump( ctx );
+    _lora_arm( ctx, cmd->timeout );
 }
-/******************************************************************************
-*  LoRa DATA
-*******************************************************************************/
-/*char lora_rxData()
+
+static void _lora_u8_str( uint8_t input, char *output )
+{
+    if( input >= 100 )
+        *output++ = '0' + input / 100;
+    if( input >= 10 )
+        *output++ = '0' + ( input / 10 ) % 10;
+    *output++ = '0' + input % 10;
+    *output   = '\0';
+}
+
+static bool _lora_seg_text( T_lora_ctx *ctx, char *text )
+{
+    T_lora_seg  *seg = &ctx->tx_seg[ ctx->tx_seg_count++ ];
+    uint16_t    len  = 0;
+
+    while( text[ len ] && ( len <= LORA_LINE_MAX ) )
+        len++;
+
+    seg->text   = text;
+    seg->data   = 0;
+    seg->len    = len;
+    ctx->tx_len    += len;
+
+    return ( ctx->tx_len <= LORA_LINE_MAX );
+}
+
+static bool _lora_seg_data( T_lora_ctx *ctx, const uint8_t *data, uint16_t len )
+{
+    T_lora_seg *seg = &ctx->tx_seg[ ctx->tx_seg_count++ ];
+
+    seg->text   = 0;
+    seg->data   = data;
+    seg->len    = len;
+
+    if( len > ( LORA_LINE_MAX - ctx->tx_len ) / 2 )
+        return false;
+    ctx->tx_len    += 2 * len;
+
+    return true;
+}
+
+static bool _lora_build( T_lora_ctx *ctx, T_lora_cmd *cmd )
+{
+    uint8_t i;
+
+    ctx->tx_seg_count   = 0;
+    ctx->tx_seg_cur     = 0;
+    ctx->tx_seg_pos     = 0;
+    ctx->tx_len         = 0;
+
+    if( !_lora_seg_text( ctx, cmd->prefix ) )
+        return false;
+    if( cmd->arg1 && !_lora_seg_text( ctx, cmd->arg1 ) )
+        return false;
+    if( cmd->port )
+    {
+        _lora_u8_str( cmd->port, ctx->tx_port );
+        if( !_lora_seg_text( ctx, ctx->tx_port ) || !_lora_seg_text( ctx, " " ) )
+            return false;
+    }
+    if( cmd->arg2 && ( !_lora_seg_text( ctx, cmd->arg2 ) || !_lora_seg_text( ctx, " " ) ) )
+        return false;
+    if( cmd->arg3 && !_lora_seg_text( ctx, cmd->arg3 ) )
+        return false;
+    if( cmd->head_len )
+    {
+        /* Queue slot may be reused before the command is fully written */
+        for( i = 0; i < cmd->head_len; i++ )
+            ctx->tx_hdr[ i ] = cmd->head[ i ];
+        if( !_lora_seg_data( ctx, ctx->tx_hdr, cmd->head_len ) )
+            return false;
+    }
+    if( cmd->data && !_lora_seg_data( ctx, cmd->data, cmd->data_len ) )
+        return false;
+
+    return _lora_seg_text( ctx, "\r\n" );
+}
+
+static void _lora_complete( T_lora_ctx *ctx, uint8_t status, char *line, uint16_t len )
+{
+    T_lora_doneFp done = ctx->cmd_done;
+
+    ctx->cmd_state      = LORA_CMD_IDLE;
+    ctx->cmd_done       = 0;
+    ctx->timer_f        = false;
+
+    if( done )
+        done( ctx, status, line, len );
+}
+
+static uint8_t _lora_block( T_lora_ctx *ctx, T_lora_cmd *cmd, char *response )
 {
-     char _data;
-     char rsp_data[30];
-     _strncpy( rsp_data, &_rx_buffer[11], 4);
-     _xtoi(rsp_data,&_data);
+    ctx->block_f        = false;
+    cmd->response   = response;
+    cmd->done       = _lora_unblock;
+
+    while( !_lora_enqueue( ctx, LORA_LANE_NORMAL, cmd ) )
+        lora_process( ctx );
+
+    while( !ctx->block_f )
+        lora_process( ctx );
 
-     return _data;
-}*/
+    return ctx->block_status;
+}
+
+static void _lora_unblock( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len )
+{
+    ctx->block_status   = status;
+    ctx->block_f        = true;
+}
 
+static void _lora_write( T_lora_ctx *ctx )
+{
+    T_lora_seg  *seg;
+    uint16_t    room;
+    uint16_t    left;
+
+    /* Walk stops when the FIFO is full and resumes from _lora_tx_pump as the
+       UART frees room, command longer than the FIFO never blocks */
+    while( ctx->tx_seg_cur < ctx->tx_seg_count )
+    {
+        seg  = &ctx->tx_seg[ ctx->tx_seg_cur ];
+        room = LORA_TX_FIFO_SIZE - ( T_lora_fifoIdx )( ctx->tx_head - ctx->tx_tail );
+        left = seg->len - ctx->tx_seg_pos;
+
+        if( seg->data )
+        {
+            /* Two hex digits per byte */
+            if( left > room / 2 )
+                left = room / 2;
+            ctx->tx_seg_pos += _lora_tx_hex( ctx, &seg->data[ ctx->tx_seg_pos ], left );
+        }
+        else
+        {
+            if( left > room )
+                left = room;
+            while( left-- )
+                _lora_tx_put( ctx, seg->text[ ctx->tx_seg_pos++ ] );
+        }
+
+        if( ctx->tx_seg_pos < seg->len )
+            return;
+
+        ctx->tx_seg_cur++;
+        ctx->tx_seg_pos = 0;
+    }
+}
+
+static void _lora_write_cut( T_lora_ctx *ctx )
+{
+    /* Buffers belong to the caller again - rest of the line is dropped but
+       it is still terminated, engine waits for the refusal before the next
+       command goes out */
+    ctx->tx_seg_count   = 0;
+    ctx->tx_seg_cur     = 0;
+    ctx->tx_seg_pos     = 0;
+    ctx->tx_len         = 0;
+    _lora_seg_text( ctx, _tx_cut );
+
+    ctx->cmd_state      = LORA_CMD_RSP;
+    ctx->cmd_rsp_count  = 1;
+    ctx->rsp_buffer     = 0;
+    ctx->rsp_downlink   = 0;
+    ctx->air_len        = 0;
+    _lora_arm( ctx, LORA_TIMEOUT_CMD );
+    _lora_tx_pump( ctx );
+}
+
+static void _lora_tx_put( T_lora_ctx *ctx, char input )
+{
+    T_lora_fifoIdx head = ctx->tx_head;
+
+    ctx->tx_fifo[ head & LORA_TX_FIFO_MASK ] = input;
+    ctx->tx_head = head + 1;
+}
+
+static uint16_t _lora_tx_hex( T_lora_ctx *ctx, const uint8_t *data, uint16_t len )
+{
+    uint16_t        count = len;
+#ifdef LORA_SWAR_HEX
+    T_lora_fifoIdx  head;
+    uint32_t        tmp;
+
+    /* Two bytes per step - four nibbles are spread to bytes of a word and
+       converted to hex digits with a single add */
+    while( len >= 2 )
+    {
+        tmp  = ( uint32_t )( data[ 0 ] >> 4 );
+        tmp |= ( uint32_t )( data[ 0 ] & 0x0F ) << 8;
+        tmp |= ( uint32_t )( data[ 1 ] >> 4 ) << 16;
+        tmp |= ( uint32_t )( data[ 1 ] & 0x0F ) << 24;
+        tmp += 0x30303030 + ( ( ( tmp + 0x06060606 ) >> 4 ) & 0x01010101 ) * 7;
+
+        head = ctx->tx_head;
+        ctx->tx_fifo[ head++ & LORA_TX_FIFO_MASK ] = ( char )tmp;
+        ctx->tx_fifo[ head++ & LORA_TX_FIFO_MASK ] = ( char )( tmp >> 8 );
+        ctx->tx_fifo[ head++ & LORA_TX_FIFO_MASK ] = ( char )( tmp >> 16 );
+        ctx->tx_fifo[ head++ & LORA_TX_FIFO_MASK ] = ( char )( tmp >> 24 );
+        ctx->tx_head = head;
+
+        data += 2;
+        len  -= 2;
+    }
+#endif
+    while( len-- )
+    {
+        _lora_tx_put( ctx, _LORA_HEX[ *data >> 4 ] );
+        _lora_tx_put( ctx, _LORA_HEX[ *data++ & 0x0F ] );
+    }
+    return count;
+}
+
+static void _lora_tx_pump( T_lora_ctx *ctx )
+{
+    _lora_write( ctx );
+
+    if( ( ctx->tx_tail == ctx->tx_head ) || hal_gpio_intGet() )
+        return;
+
+#ifdef __HAL_UART_TX_IRQ__
+    hal_uartTxIrq( 1 );
+#else
+    lora_tx_isr( ctx );
+#endif
+}
+
+static void _lora_read( T_lora_ctx *ctx, T_lora_line *line )
+{
+    uint8_t res;
+    bool    view_f;
+
+#if LORA_USE_FRAG
+    if( ctx->frag_rx_buf && line->hex_f && ( line->port == ctx->frag_rx_port ) &&
+        ( ( line->rsp == LORA_RSP_MAC_RX ) || ( line->rsp == LORA_RSP_RADIO_RX ) ) )
+        _lora_frag_rx( ctx, ( const uint8_t* )&ctx->rx_buffer[ line->offset + line->data ], line->data_len );
+#endif
+
+    if( ctx->cmd_state == LORA_CMD_IDLE )
+    {
+        hal_gpio_csSet( true );
+        if( ctx->callback_resp )
+            ctx->callback_resp( ctx, _lora_line_text( ctx, line ) );
+        hal_gpio_csSet( false );
+        return;
+    }
+
+    /* Downlink requested as binary - payload stays decoded in the storage */
+    view_f = ctx->rsp_downlink && ( ( line->rsp == LORA_RSP_MAC_RX ) || ( line->rsp == LORA_RSP_RADIO_RX ) );
+
+    if( view_f )
+    {
+        ctx->rsp_downlink->port = line->port;
+        ctx->rsp_downlink->data = ( const uint8_t* )&ctx->rx_buffer[ line->offset + line->data ];
+        ctx->rsp_downlink->len  = line->data_len;
+    }
+    else if( ctx->rsp_buffer )
+    {
+        hal_gpio_csSet( true );
+        _strcpy( ctx->rsp_buffer, _lora_line_text( ctx, line ) );
+        hal_gpio_csSet( false );
+    }
+
+    if( ctx->cmd_state == LORA_CMD_RSP )
+    {
+        res = _lora_par( line->rsp );
+
+        if( !res && ( ctx->cmd_rsp_count > 1 ) )
+        {
+            /* Module accepted the transmission, its airtime starts now */
+#if LORA_USE_DUTY
+            if( ctx->dc_mask && ctx->air_len )
+                _lora_dc_charge( ctx );
+#endif
+#if LORA_USE_STREAM
+            if( ctx->cmd_done == _lora_stream_done )
+            {
+                _lora_stream_open( ctx );
+
+                /* Stopped while the window was opening, rxstop is queued */
+                if( !ctx->stream_f )
+                {
+                    _lora_complete( ctx, LORA_RSP_ABORTED, _rx_empty, 0 );
+                    return;
+                }
+            }
+#endif
+
+            ctx->cmd_state = LORA_CMD_RSP2;
+            return;
+        }
+    }
+    else
+    {
+        res = _lora_repar( line->rsp );
+
+        /* Frame went out after ok - failed transmissions use the air as well,
+           only invalid_data_len means nothing was sent */
+        if( ctx->air_len && ( ( line->rsp == LORA_RSP_MAC_TX_OK ) || ( line->rsp == LORA_RSP_MAC_RX ) ||
+            ( line->rsp == LORA_RSP_MAC_ERR ) || ( line->rsp == LORA_RSP_RADIO_TX_OK ) ||
+            ( line->rsp == LORA_RSP_RADIO_ERR ) || ( line->rsp == LORA_RSP_ACCEPTED ) || ( line->rsp == LORA_RSP_DENIED ) ) )
+            _lora_air_charge( ctx );
+    }
+
+    if( view_f || !ctx->cmd_done )
+        _lora_complete( ctx, res, _rx_empty, 0 );
+    else
+        _lora_complete( ctx, res, _lora_line_text( ctx, line ), line->len );
+}
+
+static char* _lora_line_text( T_lora_ctx *ctx, T_lora_line *line )
+{
+    char        *text = &ctx->rx_buffer[ line->offset ];
+    char        *data = &text[ line->data ];
+    uint16_t    i     = line->data_len;
+    uint8_t     tmp;
+
+    if( line->hex_f )
+    {
+        /* Expand from the end, hex digits never overwrite unread bytes */
+        while( i-- )
+        {
+            tmp = data[ i ];
+            data[ 2 * i + 1 ] = _LORA_HEX[ tmp & 0x0F ];
+            data[ 2 * i ]     = _LORA_HEX[ tmp >> 4 ];
+        }
+        line->len    = line->data + 2 * line->data_len;
+        text[ line->len ] = '\0';
+        line->hex_f  = false;
+    }
+    return text;
+}
+
+static void _lora_rx_drain( T_lora_ctx *ctx )
+{
+    T_lora_ringIdx  tail = ctx->rx_tail;
+
+    while( tail != ctx->rx_head )
+    {
+        _lora_rx_frame( ctx, ctx->rx_ring[ tail & LORA_RX_RING_MASK ] );
+        tail++;
+    }
+    ctx->rx_tail = tail;
+}
+
+static bool _lora_rx_room( T_lora_ctx *ctx )
+{
+    uint16_t oldest;
+    uint16_t i;
+
+    if( ctx->line_head == ctx->line_tail )
+    {
+        if( ctx->rx_line_start + ctx->rx_buffer_len + 1 < LORA_RX_STORE_SIZE )
+            return true;
+        oldest = LORA_RX_STORE_SIZE;
+    }
+    else
+    {
+        oldest = ctx->rx_lines[ ctx->line_tail % LORA_RX_LINE_COUNT ].offset;
+
+        if( ctx->rx_line_start < oldest )
+            return ( ctx->rx_line_start + ctx->rx_buffer_len + 1 < oldest );
+        if( ctx->rx_line_start + ctx->rx_buffer_len + 1 < LORA_RX_STORE_SIZE )
+            return true;
+    }
+
+    /* Wrap partial line to the beginning of the storage */
+    if( !ctx->rx_line_start || ( ctx->rx_buffer_len + 1 >= oldest ) )
+        return false;
+
+    for( i = 0; i < ctx->rx_buffer_len; i++ )
+        ctx->rx_buffer[ i ] = ctx->rx_buffer[ ctx->rx_line_start + i ];
+    ctx->rx_line_start = 0;
+
+    return true;
+}
+
+static uint8_t _lora_rx_nibble( char input )
+{
+    if( ( input >= '0' ) && ( input <= '9' ) )
+        return input - '0';
+
+    input |= 0x20;
+    if( ( input >= 'a' ) && ( input <= 'f' ) )
+        return input - 'a' + 10;
+
+    return LORA_PAR_NO_NIBBLE;
+}
+
+static bool _lora_rx_reserve( T_lora_ctx *ctx )
+{
+    if( _lora_rx_room( ctx ) )
+    {
+        ctx->rx_buffer_len++;
+        return true;
+    }
+    ctx->rx_truncated++;
+
+    return false;
+}
+
+static void _lora_rx_frame( T_lora_ctx *ctx, char rx_input )
+{
+    char        *text;
+    uint8_t     nibble;
+
+    if( rx_input == '\n' )
+        return;
+
+    if( rx_input == '\r' )
+    {
+        _lora_rx_line( ctx );
+        return;
+    }
+
+    /* Payload is decoded in place, hex text is never stored */
+    if( ( ctx->par_state == LORA_PAR_DATA ) && ( rx_input != ' ' ) )
+    {
+        nibble = _lora_rx_nibble( rx_input );
+
+        if( ( nibble == LORA_PAR_NO_NIBBLE ) || !_lora_rx_reserve( ctx ) )
+            return;
+
+        /* Partial line may be moved by the reservation */
+        text = &ctx->rx_buffer[ ctx->rx_line_start ];
+
+        if( ctx->par_nibble == LORA_PAR_NO_NIBBLE )
+        {
+            ctx->par_nibble = nibble << 4;
+        }
+        else
+        {
+            text[ ctx->rx_cur.data + ctx->rx_cur.data_len++ ] = ctx->par_nibble | nibble;
+            ctx->par_nibble   = LORA_PAR_NO_NIBBLE;
+            ctx->rx_cur.hex_f = true;
+        }
+        return;
+    }
+
+    if( !_lora_rx_reserve( ctx ) )
+        return;
+
+    text = &ctx->rx_buffer[ ctx->rx_line_start ];
+    text[ ctx->rx_buffer_len - 1 ] = rx_input;
+
+    switch( ctx->par_state )
+    {
+        case LORA_PAR_KEYWORD:
+            if( rx_input != ' ' )
+                break;
+
+            ctx->rx_cur.rsp  = _lora_classify( text, ctx->rx_buffer_len - 1 );
+            ctx->rx_cur.data = ctx->rx_buffer_len;
+
+            if( ctx->rx_cur.rsp == LORA_RSP_MAC_RX )
+                ctx->par_state = LORA_PAR_PORT;
+            else if( ctx->rx_cur.rsp == LORA_RSP_RADIO_RX )
+                ctx->par_state = LORA_PAR_DATA;
+            else
+                ctx->par_state = LORA_PAR_TEXT;
+        break;
+        case LORA_PAR_PORT:
+            if( rx_input == ' ' )
+            {
+                ctx->rx_cur.data = ctx->rx_buffer_len;
+                ctx->par_state   = LORA_PAR_DATA;
+            }
+            else
+            {
+                ctx->rx_cur.port = ctx->rx_cur.port * 10 + ( rx_input - '0' );
+            }
+        break;
+        case LORA_PAR_DATA:
+            /* Separator spaces before the first hex digit */
+            if( !ctx->rx_cur.data_len && ( ctx->par_nibble == LORA_PAR_NO_NIBBLE ) )
+                ctx->rx_cur.data = ctx->rx_buffer_len;
+        break;
+    }
+}
+
+static void _lora_rx_line( T_lora_ctx *ctx )
+{
+    if( !ctx->rx_buffer_len )
+        return;
+
+    if( ctx->par_state == LORA_PAR_KEYWORD )
+        ctx->rx_cur.rsp = _lora_classify( &ctx->rx_buffer[ ctx->rx_line_start ], ctx->rx_buffer_len );
+
+    if( ( uint8_t )( ctx->line_head - ctx->line_tail ) >= LORA_RX_LINE_COUNT )
+    {
+        ctx->line_dropped++;
+    }
+    else
+    {
+        if( !ctx->rx_cur.hex_f )
+            ctx->rx_buffer[ ctx->rx_line_start + ctx->rx_buffer_len ] = '\0';
+
+        ctx->rx_cur.offset = ctx->rx_line_start;
+        ctx->rx_cur.len    = ctx->rx_buffer_len;
+        ctx->rx_lines[ ctx->line_head % LORA_RX_LINE_COUNT ] = ctx->rx_cur;
+        ctx->line_head++;
+
+        ctx->rx_line_start += ctx->rx_buffer_len + 1;
+    }
+    _lora_rx_start( ctx );
+}
+
+static void _lora_rx_start( T_lora_ctx *ctx )
+{
+    ctx->rx_buffer_len      = 0;
+    ctx->rx_cur.data        = 0;
+    ctx->rx_cur.data_len    = 0;
+    ctx->rx_cur.port        = 0;
+    ctx->rx_cur.rsp         = LORA_RSP_OTHER;
+    ctx->rx_cur.hex_f       = false;
+    ctx->par_state          = LORA_PAR_KEYWORD;
+    ctx->par_nibble         = LORA_PAR_NO_NIBBLE;
+}
+
+static bool _lora_rx_dispatch( T_lora_ctx *ctx )
+{
+    T_lora_line *line;
+
+    /* Line handed out by previous call is released only now, so parsers
+       can still examine it after lora_process returns */
+    if( ctx->line_busy_f )
+    {
+        ctx->line_tail++;
+        ctx->line_busy_f = false;
+    }
+
+    if( ctx->line_head == ctx->line_tail )
+        return false;
+
+    line         = &ctx->rx_lines[ ctx->line_tail % LORA_RX_LINE_COUNT ];
+    ctx->line_busy_f = true;
+    _lora_read( ctx, line );
+
+    return true;
+}
+
+/* --------------------------------------------------------- PUBLIC FUNCTIONS */
+
+#ifdef   __LORA_DRV_SPI__
+
+void lora_spiDriverInit( T_lora_ctx *ctx, T_LORA_P gpioObj, T_LORA_P spiObj)
+{
+    ctx->gpio   = gpioObj;
+    ctx->bus    = spiObj;
+    _hal_ctx    = 0;
+    _lora_hal( ctx );
+
+    // ... power ON
+    // ... configure CHIP
+}
+
+#endif
+#ifdef   __LORA_DRV_I2C__
+
+void lora_i2cDriverInit( T_lora_ctx *ctx, T_LORA_P gpioObj, T_LORA_P i2cObj, uint8_t slave)
+{
+    _slaveAddress = slave;
+    ctx->gpio   = gpioObj;
+    ctx->bus    = i2cObj;
+    _hal_ctx    = 0;
+    _lora_hal( ctx );
+
+    // ... power ON
+    // ... configure CHIP
+}
+
+#endif
+#ifdef   __LORA_DRV_UART__
+
+void lora_uartDriverInit( T_lora_ctx *ctx, T_LORA_P gpioObj, T_LORA_P uartObj)
+{
+    ctx->gpio   = gpioObj;
+    ctx->bus    = uartObj;
+    _hal_ctx    = 0;
+    _lora_hal( ctx );
+
+    // ... power ON
+    // ... configure CHIP
+}
+
+#endif
+
+// GPIO Only Drivers - remove in other cases
+void lora_gpioDriverInit( T_lora_ctx *ctx, T_LORA_P gpioObj)
+{
+    ctx->gpio   = gpioObj;
+    ctx->bus    = 0;
+    _hal_ctx    = 0;
+    _lora_hal( ctx );
+
+    // ... power ON
+}
+
+/* ----------------------------------------------------------- IMPLEMENTATION */
+/******************************************************************************
+*  LoRa INIT
+*******************************************************************************/
+
+void lora_init( T_lora_ctx *ctx, bool CB_default, T_lora_rspFp response_p )
+{
+    _lora_hal( ctx );
+
+    hal_gpio_rstSet( 1 );
+    Delay_100ms();
+    hal_gpio_rstSet( 0 );
+    Delay_100ms();
+    Delay_100ms();
+    Delay_100ms();
+    hal_gpio_rstSet( 1 );
+    Delay_100ms();
+    hal_gpio_csSet( 1 );
+    
+    _memset( ( uint8_t* )ctx->rx_buffer, 0, LORA_RX_STORE_SIZE );
+    
+    ctx->cmd_timeout        = LORA_TIMEOUT_CMD;
+    ctx->tx_head            = 0;
+    ctx->tx_tail            = 0;
+    ctx->tx_seg_count       = 0;
+    ctx->tx_seg_cur         = 0;
+    ctx->rx_line_start      = 0;
+    _lora_rx_start( ctx );
+    ctx->line_head          = 0;
+    ctx->line_tail          = 0;
+    ctx->line_busy_f        = false;
+    ctx->line_dropped       = 0;
+    ctx->rx_head            = 0;
+    ctx->rx_tail            = 0;
+    ctx->rx_overflow        = 0;
+    ctx->rx_high_water      = 0;
+    ctx->rx_truncated       = 0;
+    ctx->deadline           = 0;
+    ctx->timer_f            = false;
+    ctx->timeout_f          = false;
+    ctx->timer_use_f        = false;
+    ctx->clock              = 0;
+    ctx->now                = 0;
+#if LORA_USE_DUTY
+    ctx->dc_mask            = 0;
+#endif
+    ctx->air_sf             = 7;
+    ctx->air_bw             = 125;
+    ctx->air_cr             = 5;
+    ctx->air_len            = 0;
+    ctx->air_period         = 0;
+    ctx->air_budget         = 0;
+    ctx->air_start          = 0;
+    ctx->air_used           = 0;
+    ctx->air_total          = 0;
+    ctx->air_frames         = 0;
+#if LORA_USE_AGG
+    ctx->agg_len[ 0 ]       = 0;
+    ctx->agg_len[ 1 ]       = 0;
+    ctx->agg_fill           = 0;
+    ctx->agg_port           = 0;
+    ctx->agg_lane           = LORA_LANE_NORMAL;
+    ctx->agg_send_f         = false;
+    ctx->agg_flush_f        = false;
+#endif
+#if LORA_USE_FRAG
+    ctx->frag_data          = 0;
+    ctx->frag_send_f        = false;
+    ctx->frag_id            = 0;
+    ctx->frag_rx_buf        = 0;
+    ctx->frag_rx_count      = 0;
+    ctx->frag_rx_last_f     = false;
+#endif
+#if LORA_USE_STREAM
+    ctx->stream_f           = false;
+    ctx->stream_arm_f       = false;
+    ctx->stream_stop_f      = false;
+    ctx->stream_open_f      = false;
+#endif
+#if LORA_USE_BURST
+    ctx->burst_frames       = 0;
+    ctx->burst_send_f       = false;
+#endif
+    ctx->cmd_state          = LORA_CMD_IDLE;
+    ctx->cmd_rsp_count      = 0;
+    ctx->cmd_done           = 0;
+    ctx->block_f            = false;
+    ctx->block_status       = 0;
+    _memset( ( uint8_t* )ctx->cmd_head, 0, sizeof( ctx->cmd_head ) );
+    _memset( ( uint8_t* )ctx->cmd_tail, 0, sizeof( ctx->cmd_tail ) );
+    _memset( ( uint8_t* )ctx->cmd_stats, 0, sizeof( ctx->cmd_stats ) );
+    ctx->rsp_buffer         = 0;
+    ctx->rsp_downlink       = 0;
+    ctx->callback_resp      = response_p;
+    ctx->callback_default   = CB_default;
+    
+    Delay_1sec();
+}
+/******************************************************************************
+*  LoRa CMD
+*******************************************************************************/
+bool lora_cmd_async( T_lora_ctx *ctx, char *cmd, T_lora_doneFp done)
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, cmd, 0, 0, 0, 1, ctx->cmd_timeout );
+    tmp.done = done;
+
+    return _lora_enqueue( ctx, LORA_LANE_NORMAL, &tmp );
+}
+
+void lora_cmd( T_lora_ctx *ctx, char *cmd,  char *response)
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, cmd, 0, 0, 0, 1, ctx->cmd_timeout );
+    _lora_block( ctx, &tmp, response );
+}
+/******************************************************************************
+* LoRa MAC TX
+*******************************************************************************/
+bool lora_mac_tx_async( T_lora_ctx *ctx, char* payload, char* port_no, char *buffer, uint8_t lane, T_lora_doneFp done)
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_MAC_TX, payload, port_no, buffer, 2, LORA_TIMEOUT_MAC );
+    tmp.air_len     = LORA_AIR_MAC_OVERHEAD + _lora_hex_bytes( buffer );
+    tmp.done = done;
+
+    return _lora_enqueue( ctx, lane, &tmp );
+}
+
+uint8_t lora_mac_tx( T_lora_ctx *ctx, char* payload, char* port_no, char *buffer, char *response)
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_MAC_TX, payload, port_no, buffer, 2, LORA_TIMEOUT_MAC );
+    tmp.air_len     = LORA_AIR_MAC_OVERHEAD + _lora_hex_bytes( buffer );
+
+    return _lora_block( ctx, &tmp, response );
+}
+
+bool lora_mac_tx_bin_async( T_lora_ctx *ctx, uint8_t port, const uint8_t *data, uint16_t len, bool confirmed, T_lora_downlink *downlink, uint8_t lane, T_lora_doneFp done )
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_MAC_TX, ( char* )( confirmed ? _LORA_PL_CNF : _LORA_PL_UNCNF ), 0, 0, 2, LORA_TIMEOUT_MAC );
+    tmp.port        = port;
+    tmp.data        = data;
+    tmp.data_len    = len;
+    tmp.downlink    = downlink;
+    tmp.air_len     = LORA_AIR_MAC_OVERHEAD + len;
+    tmp.done        = done;
+
+    return _lora_enqueue( ctx, lane, &tmp );
+}
+
+uint8_t lora_mac_tx_bin( T_lora_ctx *ctx, uint8_t port, const uint8_t *data, uint16_t len, bool confirmed, T_lora_downlink *downlink )
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_MAC_TX, ( char* )( confirmed ? _LORA_PL_CNF : _LORA_PL_UNCNF ), 0, 0, 2, LORA_TIMEOUT_MAC );
+    tmp.port        = port;
+    tmp.data        = data;
+    tmp.data_len    = len;
+    tmp.downlink    = downlink;
+    tmp.air_len     = LORA_AIR_MAC_OVERHEAD + len;
+
+    return _lora_block( ctx, &tmp, 0 );
+}
+/******************************************************************************
+*  LoRa JOIN
+*******************************************************************************/
+bool lora_join_async( T_lora_ctx *ctx, char* join_mode, T_lora_doneFp done)
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_JOIN, join_mode, 0, 0, 2, LORA_TIMEOUT_MAC );
+    /* ABP join is local, only OTAA sends a join request */
+    tmp.air_len     = ( join_mode[ 0 ] == 'o' ) ? LORA_AIR_JOIN_LEN : 0;
+    tmp.done = done;
+
+    return _lora_enqueue( ctx, LORA_LANE_NORMAL, &tmp );
+}
+
+uint8_t lora_join( T_lora_ctx *ctx, char* join_mode, char *response)
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_JOIN, join_mode, 0, 0, 2, LORA_TIMEOUT_MAC );
+    /* ABP join is local, only OTAA sends a join request */
+    tmp.air_len     = ( join_mode[ 0 ] == 'o' ) ? LORA_AIR_JOIN_LEN : 0;
+
+    return _lora_block( ctx, &tmp, response );
+}
+/******************************************************************************
+* LORA RX
+*******************************************************************************/
+bool lora_rx_async( T_lora_ctx *ctx, char* window_size, T_lora_doneFp done)
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_RADIO_RX, window_size, 0, 0, 2, _lora_rx_timeout( window_size ) );
+    tmp.done = done;
+
+    return _lora_enqueue( ctx, LORA_LANE_NORMAL, &tmp );
+}
+
+uint8_t lora_rx( T_lora_ctx *ctx, char* window_size, char *response)
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_RADIO_RX, window_size, 0, 0, 2, _lora_rx_timeout( window_size ) );
+
+    return _lora_block( ctx, &tmp, response );
+}
+
+bool lora_rx_bin_async( T_lora_ctx *ctx, char* window_size, T_lora_downlink *downlink, T_lora_doneFp done )
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_RADIO_RX, window_size, 0, 0, 2, _lora_rx_timeout( window_size ) );
+    tmp.downlink    = downlink;
+    tmp.done        = done;
+
+    return _lora_enqueue( ctx, LORA_LANE_NORMAL, &tmp );
+}
+
+uint8_t lora_rx_bin( T_lora_ctx *ctx, char* window_size, T_lora_downlink *downlink )
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_RADIO_RX, window_size, 0, 0, 2, _lora_rx_timeout( window_size ) );
+    tmp.downlink    = downlink;
+
+    return _lora_block( ctx, &tmp, 0 );
+}
+#if LORA_USE_STREAM
+bool lora_rx_stream( T_lora_ctx *ctx, T_lora_downlink *downlink, T_lora_doneFp done )
+{
+    if( ctx->stream_f )
+        return false;
+
+    _memset( ( uint8_t* )&ctx->stream_stats, 0, sizeof( T_lora_streamStats ) );
+    ctx->stream_downlink    = downlink;
+    ctx->stream_done        = done;
+    ctx->stream_end_f       = false;
+    ctx->stream_f           = true;
+    ctx->stream_arm_f       = true;
+    _lora_stream_arm( ctx );
+
+    return true;
+}
+
+void lora_rx_stream_stop( T_lora_ctx *ctx )
+{
+    ctx->stream_f       = false;
+    ctx->stream_arm_f   = false;
+
+    if( ( ctx->cmd_state == LORA_CMD_IDLE ) || ( ctx->cmd_done != _lora_stream_done ) )
+        return;
+
+    /* Window 0 has no deadline - receiver is stopped and window closed here */
+    ctx->stream_stop_f  = true;
+    _lora_stream_arm( ctx );
+
+    if( ctx->cmd_state == LORA_CMD_RSP2 )
+        _lora_complete( ctx, LORA_RSP_ABORTED, _rx_empty, 0 );
+}
+
+void lora_rx_stream_stats( T_lora_ctx *ctx, T_lora_streamStats *stats )
+{
+    *stats = ctx->stream_stats;
+}
+#endif
+/******************************************************************************
+* LORA TX
+*******************************************************************************/
+bool lora_tx_async( T_lora_ctx *ctx, char *buffer, uint8_t lane, T_lora_doneFp done )
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_RADIO_TX, buffer, 0, 0, 2, LORA_TIMEOUT_RADIO );
+    tmp.air_len     = _lora_hex_bytes( buffer );
+    tmp.done = done;
+
+    return _lora_enqueue( ctx, lane, &tmp );
+}
+
+uint8_t lora_tx( T_lora_ctx *ctx, char *buffer )
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_RADIO_TX, buffer, 0, 0, 2, LORA_TIMEOUT_RADIO );
+    tmp.air_len     = _lora_hex_bytes( buffer );
+
+    return _lora_block( ctx, &tmp, 0 );
+}
+
+bool lora_tx_bin_async( T_lora_ctx *ctx, const uint8_t *data, uint16_t len, uint8_t lane, T_lora_doneFp done )
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_RADIO_TX, 0, 0, 0, 2, LORA_TIMEOUT_RADIO );
+    tmp.data        = data;
+    tmp.data_len    = len;
+    tmp.air_len     = len;
+    tmp.done        = done;
+
+    return _lora_enqueue( ctx, lane, &tmp );
+}
+
+uint8_t lora_tx_bin( T_lora_ctx *ctx, const uint8_t *data, uint16_t len )
+{
+    T_lora_cmd tmp;
+
+    _lora_cmd_init( &tmp, LORA_RADIO_TX, 0, 0, 0, 2, LORA_TIMEOUT_RADIO );
+    tmp.data        = data;
+    tmp.data_len    = len;
+    tmp.air_len     = len;
+
+    return _lora_block( ctx, &tmp, 0 );
+}
+#if LORA_USE_BURST
+bool lora_tx_burst( T_lora_ctx *ctx, const T_lora_frame *frames, uint16_t count, uint8_t lane, T_lora_doneFp done )
+{
+    if( ctx->burst_frames || !count )
+        return false;
+
+    _memset( ( uint8_t* )&ctx->burst_stats, 0, sizeof( T_lora_burstStats ) );
+    ctx->burst_frames   = frames;
+    ctx->burst_count    = count;
+    ctx->burst_index    = 0;
+    ctx->burst_lane     = lane;
+    ctx->burst_done     = done;
+    ctx->burst_start    = _lora_clock( ctx );
+    ctx->burst_send_f   = true;
+    _lora_burst_next( ctx );
+
+    return true;
+}
+
+void lora_tx_burst_stats( T_lora_ctx *ctx, T_lora_burstStats *stats )
+{
+    *stats = ctx->burst_stats;
+}
+#endif
+/******************************************************************************
+* LORA RX ISR
+*******************************************************************************/
+void lora_rx_isr( T_lora_ctx *ctx, char rx_input )
+{
+    T_lora_ringIdx head = ctx->rx_head;
+    T_lora_ringIdx used = head - ctx->rx_tail;
+
+    if( used >= LORA_RX_RING_SIZE )
+    {
+        ctx->rx_overflow++;
+        return;
+    }
+    ctx->rx_ring[ head & LORA_RX_RING_MASK ] = rx_input;
+    ctx->rx_head = head + 1;
+
+    if( ++used > ctx->rx_high_water )
+        ctx->rx_high_water = used;
+}
+/******************************************************************************
+* LORA TX ISR
+*******************************************************************************/
+void lora_tx_isr( T_lora_ctx *ctx )
+{
+    T_lora_fifoIdx tail = ctx->tx_tail;
+
+    /* INT pin holds transmission, lora_process enables interrupt again */
+    if( ( tail == ctx->tx_head ) || hal_gpio_intGet() )
+    {
+#ifdef __HAL_UART_TX_IRQ__
+        hal_uartTxIrq( 0 );
+#endif
+        return;
+    }
+    hal_uartWrite( ctx->tx_fifo[ tail & LORA_TX_FIFO_MASK ] );
+    ctx->tx_tail = tail + 1;
+}
+/******************************************************************************
+* LORA RX STATS
+*******************************************************************************/
+void lora_rx_stats( T_lora_ctx *ctx, T_lora_rxStats *stats )
+{
+    stats->overflow     = ctx->rx_overflow;
+    stats->truncated    = ctx->rx_truncated;
+    stats->high_water   = ctx->rx_high_water;
+    stats->dropped      = ctx->line_dropped;
+}
+
+uint8_t lora_rsp_code( char *line )
+{
+    uint16_t len = 0;
+
+    while( line[ len ] && ( line[ len ] != ' ' ) && ( line[ len ] != '\r' ) &&
+           ( line[ len ] != '\n' ) && ( len <= LORA_KEYWORD_MAX ) )
+        len++;
+
+    return _lora_classify( line, len );
+}
+/******************************************************************************
+* LORA TICK ISR
+*******************************************************************************/
+void lora_tick_isr( T_lora_ctx *ctx )
+{
+    ctx->clock++;
+    _lora_deadline( ctx );
+}
+/******************************************************************************
+* LoRa TICK CONF
+*******************************************************************************/
+void lora_tick_conf( T_lora_ctx *ctx, uint32_t timer_limit )
+{
+    if ( timer_limit )
+    {
+        ctx->cmd_timeout = timer_limit;
+        ctx->timer_use_f = true;
+    } 
+    else 
+    {
+        ctx->cmd_timeout = LORA_TIMEOUT_CMD;
+        ctx->timer_use_f = false;
+    }
+}
+/******************************************************************************
+* LoRa TIME CONF
+*******************************************************************************/
+void lora_time_conf( T_lora_ctx *ctx, T_lora_nowFp now )
+{
+    ctx->now = now;
+    _lora_clock( ctx );
+}
+/******************************************************************************
+* LoRa TIME LEFT
+*******************************************************************************/
+uint32_t lora_time_left( T_lora_ctx *ctx )
+{
+    int32_t left;
+
+    if( !ctx->timer_use_f || !ctx->timer_f )
+        return 0xFFFFFFFF;
+
+    left = ( int32_t )( ctx->deadline - _lora_clock( ctx ) );
+
+    return ( left > 0 ) ? ( uint32_t )left : 0;
+}
+/******************************************************************************
+* LoRa AIRTIME
+*******************************************************************************/
+uint32_t lora_toa( uint8_t sf, uint16_t bw, uint8_t cr, uint16_t len )
+{
+    uint32_t    tsym;
+    int32_t     num;
+    int32_t     den;
+    uint32_t    nsym = 8;
+
+    if( ( sf < 7 ) || ( sf > 12 ) )
+        return 0;
+
+    /* Symbol time from the table, halved for every doubling of bandwidth */
+    tsym = _LORA_TSYM[ sf - 7 ];
+    if( bw == 250 )
+        tsym >>= 1;
+    else if( bw == 500 )
+        tsym >>= 2;
+
+    /* Explicit header and CRC, low data rate optimization from 16 ms symbol */
+    num = 8 * ( int32_t )len - 4 * sf + 44;
+    den = 4 * ( sf - ( ( tsym >= 16384 ) ? 2 : 0 ) );
+
+    if( num > 0 )
+        nsym += ( ( num + den - 1 ) / den ) * cr;
+
+    /* Preamble of 8 + 4.25 symbols, rounded up to ms */
+    return ( tsym * ( 49 + 4 * nsym ) / 4 + 999 ) / 1000;
+}
+
+void lora_airtime_conf( T_lora_ctx *ctx, uint8_t sf, uint16_t bw, uint8_t cr )
+{
+    ctx->air_sf = sf;
+    ctx->air_bw = bw;
+    ctx->air_cr = cr;
+}
+
+void lora_airtime_budget( T_lora_ctx *ctx, uint32_t period, uint32_t budget )
+{
+    ctx->air_period = period;
+    ctx->air_budget = budget;
+    ctx->air_start  = _lora_clock( ctx );
+    ctx->air_used   = 0;
+}
+
+void lora_airtime_stats( T_lora_ctx *ctx, T_lora_airtime *stats )
+{
+    uint32_t now = _lora_clock( ctx );
+
+    if( ctx->air_period && ( ( uint32_t )( now - ctx->air_start ) >= ctx->air_period ) )
+    {
+        ctx->air_start  = now;
+        ctx->air_used   = 0;
+    }
+    stats->total    = ctx->air_total;
+    stats->frames   = ctx->air_frames;
+    stats->used     = ctx->air_used;
+    stats->left     = ( ctx->air_budget > ctx->air_used ) ? ctx->air_budget - ctx->air_used : 0;
+    stats->reset    = ctx->air_period ? ctx->air_period - ( now - ctx->air_start ) : 0;
+}
+
+bool lora_airtime_fits( T_lora_ctx *ctx, uint16_t len )
+{
+    T_lora_airtime stats;
+
+    if( !ctx->air_budget )
+        return true;
+
+    lora_airtime_stats( ctx, &stats );
+
+    return lora_toa( ctx->air_sf, ctx->air_bw, ctx->air_cr, len ) <= stats.left;
+}
+uint8_t lora_max_payload( T_lora_ctx *ctx )
+{
+    /* EU868 DR0 ~ DR2, DR3, DR4 and faster */
+    if( ctx->air_sf >= 10 )
+        return 51;
+    if( ctx->air_sf == 9 )
+        return 115;
+
+    return 222;
+}
+#if LORA_USE_AGG
+/******************************************************************************
+* LoRa AGGREGATION
+*******************************************************************************/
+void lora_agg_conf( T_lora_ctx *ctx, uint8_t port, bool confirmed, uint32_t max_age, T_lora_doneFp done )
+{
+    ctx->agg_port       = port;
+    ctx->agg_confirmed  = confirmed;
+    ctx->agg_age        = max_age;
+    ctx->agg_done       = done;
+}
+
+bool lora_agg_add( T_lora_ctx *ctx, const uint8_t *record, uint8_t len, bool urgent )
+{
+    uint8_t     room = lora_max_payload( ctx );
+    uint8_t     *buf;
+    uint8_t     i;
+
+    if( room > LORA_AGG_SIZE )
+        room = LORA_AGG_SIZE;
+
+    if( !ctx->agg_port || ( len >= room ) )
+        return false;
+
+    /* Record does not fit - current frame goes out first */
+    if( ctx->agg_len[ ctx->agg_fill ] + 1 + len > room )
+    {
+        ctx->agg_flush_f = true;
+        _lora_agg_send( ctx );
+
+        if( ctx->agg_len[ ctx->agg_fill ] + 1 + len > room )
+            return false;
+    }
+
+    if( !ctx->agg_len[ ctx->agg_fill ] )
+        ctx->agg_first = _lora_clock( ctx );
+
+    buf = &ctx->agg_buf[ ctx->agg_fill ][ ctx->agg_len[ ctx->agg_fill ] ];
+    *buf++ = len;
+    for( i = 0; i < len; i++ )
+        *buf++ = record[ i ];
+    ctx->agg_len[ ctx->agg_fill ] += 1 + len;
+
+    if( urgent )
+        ctx->agg_lane = LORA_LANE_URGENT;
+    if( urgent || ( ctx->agg_len[ ctx->agg_fill ] == room ) )
+    {
+        ctx->agg_flush_f = true;
+        _lora_agg_send( ctx );
+    }
+    return true;
+}
+
+void lora_agg_flush( T_lora_ctx *ctx )
+{
+    ctx->agg_flush_f = true;
+    _lora_agg_send( ctx );
+}
+#endif
+#if LORA_USE_FRAG
+/******************************************************************************
+* LoRa FRAGMENTATION
+*******************************************************************************/
+bool lora_frag_send( T_lora_ctx *ctx, uint8_t port, const uint8_t *blob, uint16_t len, bool confirmed, T_lora_doneFp done )
+{
+    uint16_t size = lora_max_payload( ctx ) - LORA_FRAG_HDR;
+    uint16_t count;
+
+    if( ctx->frag_data || !len )
+        return false;
+
+    count = ( len + size - 1 ) / size;
+    if( count > 255 )
+        return false;
+
+    ctx->frag_data      = blob;
+    ctx->frag_len       = len;
+    ctx->frag_size      = size;
+    ctx->frag_port      = port;
+    ctx->frag_id++;
+    ctx->frag_index     = 0;
+    ctx->frag_count     = count;
+    ctx->frag_confirmed = confirmed;
+    ctx->frag_done      = done;
+    ctx->frag_send_f    = true;
+    _lora_frag_next( ctx );
+
+    return true;
+}
+
+void lora_frag_rx_conf( T_lora_ctx *ctx, uint8_t port, uint8_t *buf, uint16_t size, T_lora_fragFp done )
+{
+    ctx->frag_rx_buf    = buf;
+    ctx->frag_rx_size   = size;
+    ctx->frag_rx_port   = port;
+    ctx->frag_rx_count  = 0;
+    ctx->frag_rx_tail   = 0;
+    ctx->frag_rx_last_f = false;
+    ctx->frag_rx_done   = done;
+    _memset( ( uint8_t* )&ctx->frag_rx_stats, 0, sizeof( T_lora_fragStats ) );
+}
+
+void lora_frag_rx_stats( T_lora_ctx *ctx, T_lora_fragStats *stats )
+{
+    *stats = ctx->frag_rx_stats;
+}
+#endif
+/******************************************************************************
+* LoRa FEC
+*******************************************************************************/
+void lora_fec_init( T_lora_fec *fec, uint8_t window )
+{
+    _memset( ( uint8_t* )fec, 0, sizeof( T_lora_fec ) );
+    fec->window = ( window > LORA_FEC_INDEX_MASK ) ? LORA_FEC_INDEX_MASK : ( window ? window : 1 );
+}
+
+uint8_t lora_fec_encode( T_lora_fec *fec, const uint8_t *data, uint8_t len, uint8_t *out )
+{
+    uint8_t i;
+
+    if( ( len > LORA_FEC_SIZE ) || ( fec->index >= fec->window ) )
+        return 0;
+
+    out[ 0 ] = fec->group;
+    out[ 1 ] = ( fec->window << LORA_FEC_WINDOW_SHIFT ) | fec->index;
+
+    /* Length goes in too, recovered frame gets its own size back */
+    fec->parity[ 0 ] ^= len;
+    for( i = 0; i < len; i++ )
+    {
+        out[ LORA_FEC_HDR + i ] = data[ i ];
+        fec->parity[ 1 + i ]   ^= data[ i ];
+    }
+    if( len + 1 > fec->parity_len )
+        fec->parity_len = len + 1;
+
+    fec->index++;
+
+    return LORA_FEC_HDR + len;
+}
+
+uint8_t lora_fec_parity( T_lora_fec *fec, uint8_t *out )
+{
+    uint8_t len = fec->parity_len;
+    uint8_t i;
+
+    if( fec->index < fec->window )
+        return 0;
+
+    out[ 0 ] = fec->group;
+    out[ 1 ] = ( fec->window << LORA_FEC_WINDOW_SHIFT ) | fec->window;
+    for( i = 0; i < len; i++ )
+        out[ LORA_FEC_HDR + i ] = fec->parity[ i ];
+
+    _memset( fec->parity, 0, len );
+    fec->parity_len = 0;
+    fec->index      = 0;
+    fec->group++;
+
+    return LORA_FEC_HDR + len;
+}
+
+void lora_unfec_init( T_lora_unfec *fec )
+{
+    _memset( ( uint8_t* )fec, 0, sizeof( T_lora_unfec ) );
+}
+
+uint8_t lora_fec_decode( T_lora_unfec *fec, const uint8_t *in, uint8_t len )
+{
+    uint8_t     window;
+    uint8_t     index;
+    uint16_t    bit;
+    uint8_t     i;
+
+    if( ( len < LORA_FEC_HDR ) || ( len > LORA_FEC_HDR + LORA_FEC_SIZE + 1 ) )
+        return 0;
+
+    window  = in[ 1 ] >> LORA_FEC_WINDOW_SHIFT;
+    index   = in[ 1 ] & LORA_FEC_INDEX_MASK;
+    len    -= LORA_FEC_HDR;
+
+    if( !window || ( index > window ) || ( ( index < window ) && ( len > LORA_FEC_SIZE ) ) )
+        return 0;
+
+    if( !fec->group_f || ( in[ 0 ] != fec->group ) || ( window != fec->window ) )
+    {
+        _memset( fec->acc, 0, sizeof( fec->acc ) );
+        fec->got        = 0;
+        fec->window     = window;
+        fec->group      = in[ 0 ];
+        fec->group_f    = true;
+    }
+
+    bit = 1 << index;
+    if( fec->got & bit )
+        return 0;
+    fec->got |= bit;
+
+    if( index == window )
+    {
+        for( i = 0; i < len; i++ )
+            fec->acc[ i ] ^= in[ LORA_FEC_HDR + i ];
+        return 0;
+    }
+
+    fec->acc[ 0 ] ^= len;
+    for( i = 0; i < len; i++ )
+        fec->acc[ 1 + i ] ^= in[ LORA_FEC_HDR + i ];
+
+    return len;
+}
+
+uint8_t lora_fec_recover( T_lora_unfec *fec, uint8_t *out, uint8_t *index )
+{
+    uint16_t    all = ( 1 << ( fec->window + 1 ) ) - 1;
+    uint16_t    lost;
+    uint8_t     len = fec->acc[ 0 ];
+    uint8_t     i;
+
+    if( !fec->group_f || !( fec->got & ( 1 << fec->window ) ) )
+        return 0;
+
+    /* Exactly one data frame missing */
+    lost = all & ~fec->got;
+    if( !lost || ( lost & ( lost - 1 ) ) || ( len > LORA_FEC_SIZE ) )
+        return 0;
+
+    for( i = 0; !( lost & ( 1 << i ) ); i++ );
+    *index = i;
+    for( i = 0; i < len; i++ )
+        out[ i ] = fec->acc[ 1 + i ];
+
+    fec->got |= lost;
+
+    return len;
+}
+/******************************************************************************
+* LoRa PACK
+*******************************************************************************/
+void lora_pack_init( T_lora_pack *pack )
+{
+    _memset( ( uint8_t* )pack, 0, sizeof( T_lora_pack ) );
+}
+
+uint8_t lora_pack_encode( T_lora_pack *pack, const int32_t *values, uint8_t count, bool lz, uint8_t *out, uint8_t size )
+{
+    uint8_t     body[ LORA_PACK_FIELDS * 5 ];
+    uint16_t    len = 0;
+    uint8_t     hdr = 2;
+    uint16_t    packed;
+    bool        delta;
+    uint16_t    i;
+
+    /* Count shares the flags byte */
+    if( !count || ( count > LORA_PACK_FIELDS ) || ( count > LORA_PACK_COUNT_MASK ) || ( size < 3 ) )
+        return 0;
+
+    delta = pack->ref_f && ( pack->ref_count == count );
+
+    for( i = 0; i < count; i++ )
+    {
+        /* Wrapping difference, decoder adds it back the same way */
+        if( delta )
+            len += _lora_varint_put( ( int32_t )( ( uint32_t )values[ i ] - ( uint32_t )pack->ref[ i ] ), &body[ len ] );
+        else
+            len += _lora_varint_put( values[ i ], &body[ len ] );
+    }
+
+    out[ 0 ] = pack->seq;
+    out[ 1 ] = count | ( delta ? LORA_PACK_DELTA : 0 );
+    if( delta )
+        out[ hdr++ ] = pack->ref_seq;
+
+    packed = lz ? lora_lz_encode( body, len, &out[ hdr ], size - hdr ) : 0;
+
+    if( packed && ( packed < len ) )
+    {
+        out[ 1 ] |= LORA_PACK_LZ;
+    }
+    else
+    {
+        if( hdr + len > size )
+            return 0;
+        for( i = 0; i < len; i++ )
+            out[ hdr + i ] = body[ i ];
+        packed = len;
+    }
+
+    for( i = 0; i < count; i++ )
+        pack->pend[ i ] = values[ i ];
+    pack->pend_count = count;
+    pack->pend_seq   = pack->seq++;
+
+    return hdr + packed;
+}
+
+void lora_pack_ack( T_lora_pack *pack )
+{
+    uint8_t i;
+
+    for( i = 0; i < pack->pend_count; i++ )
+        pack->ref[ i ] = pack->pend[ i ];
+    pack->ref_count = pack->pend_count;
+    pack->ref_seq   = pack->pend_seq;
+    pack->ref_f     = ( pack->pend_count != 0 );
+}
+
+void lora_unpack_init( T_lora_unpack *unpack )
+{
+    _memset( ( uint8_t* )unpack, 0, sizeof( T_lora_unpack ) );
+}
+
+uint8_t lora_pack_decode( T_lora_unpack *unpack, const uint8_t *in, uint16_t len, int32_t *values )
+{
+    uint8_t     body[ LORA_PACK_FIELDS * 5 ];
+    const uint8_t *src;
+    int32_t     *ref = 0;
+    int32_t     *slot;
+    uint16_t    body_len;
+    uint16_t    pos = 0;
+    uint8_t     hdr = 2;
+    uint8_t     count;
+    uint8_t     i;
+
+    if( len < 2 )
+        return 0;
+
+    count = in[ 1 ] & LORA_PACK_COUNT_MASK;
+    if( !count || ( count > LORA_PACK_FIELDS ) )
+        return 0;
+
+    if( in[ 1 ] & LORA_PACK_DELTA )
+    {
+        if( len < 3 )
+            return 0;
+
+        for( i = 0; i < LORA_PACK_HISTORY; i++ )
+            if( ( unpack->hist_count[ i ] == count ) && ( unpack->hist_seq[ i ] == in[ 2 ] ) )
+                ref = unpack->hist[ i ];
+        if( !ref )
+            return 0;
+        hdr++;
+    }
+
+    if( in[ 1 ] & LORA_PACK_LZ )
+    {
+        body_len = lora_lz_decode( &in[ hdr ], len - hdr, body, sizeof( body ) );
+        if( !body_len )
+            return 0;
+        src = body;
+    }
+    else
+    {
+        body_len = len - hdr;
+        src      = &in[ hdr ];
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        if( !_lora_varint_get( src, body_len, &pos, &values[ i ] ) )
+            return 0;
+        if( ref )
+            values[ i ] = ( int32_t )( ( uint32_t )values[ i ] + ( uint32_t )ref[ i ] );
+    }
+
+    /* Oldest record is replaced */
+    slot = unpack->hist[ unpack->next ];
+    for( i = 0; i < count; i++ )
+        slot[ i ] = values[ i ];
+    unpack->hist_seq[ unpack->next ]   = in[ 0 ];
+    unpack->hist_count[ unpack->next ] = count;
+    unpack->next = ( unpack->next + 1 ) % LORA_PACK_HISTORY;
+
+    return count;
+}
+
+uint16_t lora_lz_encode( const uint8_t *in, uint16_t len, uint8_t *out, uint16_t size )
+{
+    uint16_t    pos = 0;
+    uint16_t    o   = 0;
+    uint16_t    ctrl = 0;
+    uint8_t     bit = 8;
+    uint8_t     best_len;
+    uint8_t     best_off;
+    uint8_t     off;
+    uint8_t     l;
+
+    while( pos < len )
+    {
+        if( bit == 8 )
+        {
+            if( o >= size )
+                return 0;
+            ctrl = o++;
+            out[ ctrl ] = 0;
+            bit = 0;
+        }
+
+        /* Longest match inside the window, nearest wins ties */
+        best_len = 0;
+        best_off = 0;
+        for( off = 1; ( off <= LORA_LZ_WINDOW ) && ( off <= pos ); off++ )
+        {
+            l = 0;
+            while( ( l < LORA_LZ_MAX ) && ( pos + l < len ) && ( in[ pos + l ] == in[ pos - off + l ] ) )
+                l++;
+            if( l > best_len )
+            {
+                best_len = l;
+                best_off = off;
+            }
+        }
+
+        if( o >= size )
+            return 0;
+
+        if( best_len >= LORA_LZ_MIN )
+        {
+            out[ ctrl ] |= 1 << bit;
+            out[ o++ ] = ( ( best_off - 1 ) << 3 ) | ( best_len - LORA_LZ_MIN );
+            pos += best_len;
+        }
+        else
+        {
+            out[ o++ ] = in[ pos++ ];
+        }
+        bit++;
+    }
+    return o;
+}
+
+uint16_t lora_lz_decode( const uint8_t *in, uint16_t len, uint8_t *out, uint16_t size )
+{
+    uint16_t    i = 0;
+    uint16_t    o = 0;
+    uint8_t     ctrl;
+    uint8_t     bit;
+    uint8_t     off;
+    uint8_t     l;
+
+    while( i < len )
+    {
+        ctrl = in[ i++ ];
+
+        for( bit = 0; ( bit < 8 ) && ( i < len ); bit++ )
+        {
+            if( ctrl & ( 1 << bit ) )
+            {
+                off = ( in[ i ] >> 3 ) + 1;
+                l   = ( in[ i ] & 0x07 ) + LORA_LZ_MIN;
+                i++;
+
+                if( ( off > o ) || ( o + l > size ) )
+                    return 0;
+
+                /* Overlapping copy repeats the pattern */
+                while( l-- )
+                {
+                    out[ o ] = out[ o - off ];
+                    o++;
+                }
+            }
+            else
+            {
+                if( o >= size )
+                    return 0;
+                out[ o++ ] = in[ i++ ];
+            }
+        }
+    }
+    return o;
+}
+#if LORA_USE_DUTY
+/******************************************************************************
+* LoRa DUTY CYCLE
+*******************************************************************************/
+void lora_duty_conf( T_lora_ctx *ctx, uint8_t band_mask )
+{
+    uint8_t i;
+
+    ctx->dc_mask    = band_mask;
+
+    for( i = 0; i < LORA_BAND_COUNT; i++ )
+        ctx->dc_free[ i ] = _lora_clock( ctx );
+}
+
+uint32_t lora_duty_wait( T_lora_ctx *ctx )
+{
+    uint32_t    now  = _lora_clock( ctx );
+    uint32_t    wait = 0xFFFFFFFF;
+    int32_t     left;
+    uint8_t     i;
+
+    if( !ctx->dc_mask )
+        return 0;
+
+    for( i = 0; i < LORA_BAND_COUNT; i++ )
+    {
+        if( !( ctx->dc_mask & ( 1 << i ) ) )
+            continue;
+
+        left = ( int32_t )( ctx->dc_free[ i ] - now );
+        if( left <= 0 )
+            return 0;
+        if( ( uint32_t )left < wait )
+            wait = left;
+    }
+    return wait;
+}
+#endif
+/******************************************************************************
+*  LoRa PROCESS
+*******************************************************************************/
+void lora_process( T_lora_ctx *ctx )
+{
+#ifndef __HAL_UART_RX_IRQ__
+    uint16_t i;
+#endif
+    bool     cut_f;
+
+    _lora_hal( ctx );
+
+#ifndef __HAL_UART_RX_IRQ__
+    /* Polled HAL - ring is framed while it fills, lines longer than the
+       ring arrive whole */
+    for( i = 0; ( i < LORA_RX_POLL_MAX ) && hal_uartReady(); i++ )
+    {
+        lora_rx_isr( ctx, hal_uartRead() );
+        if( ( T_lora_ringIdx )( ctx->rx_head - ctx->rx_tail ) >= LORA_RX_RING_SIZE / 2 )
+            _lora_rx_drain( ctx );
+    }
+#endif
+
+    _lora_tx_pump( ctx );
+    _lora_rx_drain( ctx );
+    _lora_rx_dispatch( ctx );
+
+    /* Tickless mode - deadline is checked after received lines are handled */
+    if( ctx->now )
+    {
+        _lora_clock( ctx );
+        _lora_deadline( ctx );
+    }
+
+    if ( ctx->timeout_f )
+    {
+        ctx->timeout_f = false;
+        if( ctx->cmd_state != LORA_CMD_IDLE )
+        {
+            cut_f = ( ctx->tx_seg_cur < ctx->tx_seg_count );
+            _lora_complete( ctx, LORA_RSP_TIMEOUT, _rx_empty, 0 );
+            if( cut_f )
+                _lora_write_cut( ctx );
+        }
+    }
+
+#if LORA_USE_AGG
+    _lora_agg_poll( ctx );
+#endif
+#if LORA_USE_FRAG
+    _lora_frag_next( ctx );
+#endif
+#if LORA_USE_STREAM
+    _lora_stream_arm( ctx );
+#endif
+#if LORA_USE_BURST
+    _lora_burst_next( ctx );
+#endif
+
+    /* Lines left after the final response are unsolicited, deliver them
+       before the next queued command goes out */
+    if( ctx->cmd_state == LORA_CMD_IDLE )
+    {
+        while( _lora_rx_dispatch( ctx ) );
+        _lora_next( ctx );
+    }
+}
+/******************************************************************************
+*  LoRa QUEUE STATS
+*******************************************************************************/
+void lora_queue_stats( T_lora_ctx *ctx, uint8_t lane, T_lora_queueStats *stats )
+{
+    *stats          = ctx->cmd_stats[ lane ];
+    stats->depth    = ctx->cmd_head[ lane ] - ctx->cmd_tail[ lane ];
+}
 /* -------------------------------------------------------------------------- */
 /*
   __lora_driver.c
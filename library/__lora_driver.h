@@ -51,6 +51,67 @@
 //  #define   __LORA_DRV_SPI__                            /**<     @macro __LORA_DRV_SPI__  @brief SPI driver selector */
 //  #define   __LORA_DRV_I2C__                            /**<     @macro __LORA_DRV_I2C__  @brief I2C driver selector */                                          
   #define   __LORA_DRV_UART__                           /**<     @macro __LORA_DRV_UART__ @brief UART driver selector */ 
+//  #define   __HAL_SIM__                                 /**<     @macro __HAL_SIM__       @brief Simulated module instead of target HAL */
+
+#ifndef LORA_RX_RING_SIZE
+  #define   LORA_RX_RING_SIZE                 128       /**<     @macro LORA_RX_RING_SIZE @brief UART receive ring size ( power of two ) */
+#endif
+#ifndef LORA_TX_FIFO_SIZE
+  #define   LORA_TX_FIFO_SIZE                 128       /**<     @macro LORA_TX_FIFO_SIZE @brief UART transmit FIFO size ( power of two ) */
+#endif
+#ifndef LORA_CMD_QUEUE_SIZE
+  #define   LORA_CMD_QUEUE_SIZE               4         /**<     @macro LORA_CMD_QUEUE_SIZE @brief Commands waiting in each lane ( power of two ) */
+#endif
+  #define   LORA_PAYLOAD_MAX                  255       /**<     @macro LORA_PAYLOAD_MAX @brief Longest radio tx / radio_rx payload ( bytes ) */
+  #define   LORA_LINE_MAX                     ( 10 + 2 * LORA_PAYLOAD_MAX + 2 ) /**< @macro LORA_LINE_MAX @brief Longest command or response line, keyword and payload as hex */
+#ifndef LORA_RX_STORE_SIZE
+  #define   LORA_RX_STORE_SIZE                ( LORA_LINE_MAX + 64 ) /**< @macro LORA_RX_STORE_SIZE @brief Storage for received lines ( at least LORA_LINE_MAX ) */
+#endif
+#ifndef LORA_RX_LINE_COUNT
+  #define   LORA_RX_LINE_COUNT                4         /**<     @macro LORA_RX_LINE_COUNT @brief Number of completed lines waiting for processing ( power of two ) */
+#endif
+#ifndef LORA_RX_POLL_MAX
+  #define   LORA_RX_POLL_MAX                  512       /**<     @macro LORA_RX_POLL_MAX @brief Bytes taken from a polled HAL in one lora_process call */
+#endif
+#ifndef LORA_TIMEOUT_CMD
+  #define   LORA_TIMEOUT_CMD                  3000      /**<     @macro LORA_TIMEOUT_CMD @brief Default deadline of plain commands ( ms ) */
+#endif
+#ifndef LORA_TIMEOUT_RADIO
+  #define   LORA_TIMEOUT_RADIO                15000     /**<     @macro LORA_TIMEOUT_RADIO @brief Deadline of radio tx and windowed radio rx ( ms ) */
+#endif
+#ifndef LORA_TIMEOUT_MAC
+  #define   LORA_TIMEOUT_MAC                  60000     /**<     @macro LORA_TIMEOUT_MAC @brief Deadline of mac tx and mac join, retransmissions included ( ms ) */
+#endif
+#ifndef LORA_USE_DUTY
+  #define   LORA_USE_DUTY                     1         /**<     @macro LORA_USE_DUTY @brief Duty cycle scheduler, 0 leaves out lora_duty_xxx */
+#endif
+#ifndef LORA_USE_AGG
+  #define   LORA_USE_AGG                      1         /**<     @macro LORA_USE_AGG @brief Uplink aggregation, 0 leaves out lora_agg_xxx and both frame buffers */
+#endif
+#ifndef LORA_USE_FRAG
+  #define   LORA_USE_FRAG                     1         /**<     @macro LORA_USE_FRAG @brief Fragmented send and reassembly, 0 leaves out lora_frag_xxx */
+#endif
+#ifndef LORA_USE_STREAM
+  #define   LORA_USE_STREAM                   1         /**<     @macro LORA_USE_STREAM @brief Continuous receive, 0 leaves out lora_rx_stream_xxx */
+#endif
+#ifndef LORA_USE_BURST
+  #define   LORA_USE_BURST                    1         /**<     @macro LORA_USE_BURST @brief Radio tx burst, 0 leaves out lora_tx_burst_xxx */
+#endif
+#ifndef LORA_AGG_SIZE
+  #define   LORA_AGG_SIZE                     222       /**<     @macro LORA_AGG_SIZE @brief Uplink aggregation buffer, two are kept ( max 255 ) */
+#endif
+#ifndef LORA_PACK_FIELDS
+  #define   LORA_PACK_FIELDS                  8         /**<     @macro LORA_PACK_FIELDS @brief Values in one compressed record ( max 63 ) */
+#endif
+#ifndef LORA_FRAG_MAX
+  #define   LORA_FRAG_MAX                     64        /**<     @macro LORA_FRAG_MAX @brief Fragments of one reassembled blob ( multiple of 8, max 255 ) */
+#endif
+#ifndef LORA_PACK_HISTORY
+  #define   LORA_PACK_HISTORY                 4         /**<     @macro LORA_PACK_HISTORY @brief Frames kept by the decoder as delta references */
+#endif
+#ifndef LORA_FEC_SIZE
+  #define   LORA_FEC_SIZE                     64        /**<     @macro LORA_FEC_SIZE @brief Largest payload protected by parity frames ( max 253 ) */
+#endif
 
                                                                        /** @} */
 /** @defgroup LORA_VAR Variables */                           /** @{ */
@@ -63,8 +124,545 @@
 extern char LORA_CMD_SYS_GET_VER[];
 extern char LORA_CMD_MAC_PAUSE[];
 extern char LORA_CMD_RADIO_SET_WDT[];
+extern char LORA_CMD_RADIO_RXSTOP[];
 extern char LORA_ARG_0[];
 
+/**
+ * @enum T_lora_rsp
+ * @brief Module responses and command status codes
+ *
+ * Blocking calls and completion callbacks report these values. Same
+ * invalid_data_len response is reported as LORA_RSP_INVALID_DATA_LEN when it
+ * is the first and as LORA_RSP_TX_INVALID_DATA_LEN when it is the second
+ * response to the command.
+ */
+typedef enum
+{
+    LORA_RSP_OK                     = 0,
+    LORA_RSP_INVALID_PARAM          = 1,
+    LORA_RSP_NOT_JOINED             = 2,
+    LORA_RSP_NO_FREE_CH             = 3,
+    LORA_RSP_SILENT                 = 4,
+    LORA_RSP_FRAME_COUNTER_ERR      = 5,
+    LORA_RSP_BUSY                   = 6,
+    LORA_RSP_MAC_PAUSED             = 7,
+    LORA_RSP_INVALID_DATA_LEN       = 8,
+    LORA_RSP_KEYS_NOT_INIT          = 9,
+    LORA_RSP_MAC_ERR                = 10,
+    LORA_RSP_MAC_TX_OK              = 11,
+    LORA_RSP_MAC_RX                 = 12,
+    LORA_RSP_TX_INVALID_DATA_LEN    = 13,
+    LORA_RSP_RADIO_ERR              = 14,
+    LORA_RSP_RADIO_TX_OK            = 15,
+    LORA_RSP_RADIO_RX               = 16,
+    LORA_RSP_ACCEPTED               = 17,
+    LORA_RSP_DENIED                 = 18,
+    LORA_RSP_OTHER                  = 19,   /**< not a response keyword */
+    LORA_RSP_ABORTED                = 253,  /**< receive window closed by the host */
+    LORA_RSP_OVERFLOW               = 254,  /**< command longer than transfer size, not sent */
+    LORA_RSP_TIMEOUT                = 255   /**< host timer expired */
+
+}T_lora_rsp;
+
+/**
+ * Command Queue Lanes */
+#define LORA_LANE_NORMAL              0
+#define LORA_LANE_URGENT              1
+#define LORA_LANE_COUNT               2
+
+/**
+ * EU868 Duty Cycle Sub-bands */
+#define LORA_BAND_G                   0x01      /**< 865.0 - 868.0 MHz, 1 % */
+#define LORA_BAND_G1                  0x02      /**< 868.0 - 868.6 MHz, 1 %, RN2483 default channels */
+#define LORA_BAND_G2                  0x04      /**< 868.7 - 869.2 MHz, 0.1 % */
+#define LORA_BAND_G3                  0x08      /**< 869.4 - 869.65 MHz, 10 % */
+#define LORA_BAND_G4                  0x10      /**< 869.7 - 870.0 MHz, 1 % */
+#define LORA_BAND_COUNT               5
+
+/**
+ * @typedef T_lora_ctx
+ * @brief Driver context, one for each module
+ */
+typedef struct T_lora_ctx T_lora_ctx;
+
+/**
+ * @typedef T_lora_doneFp
+ * @brief Command completion callback
+ *
+ * Called from @link lora_process @endlink with the context of the module,
+ * the command status ( same values as returned by blocking functions ) and
+ * the last response line. Response is valid only until the callback returns.
+ */
+typedef void ( *T_lora_doneFp )( T_lora_ctx *ctx, uint8_t status, char *response, uint16_t len );
+
+/**
+ * @typedef T_lora_rspFp
+ * @brief Unsolicited response callback
+ */
+typedef void ( *T_lora_rspFp )( T_lora_ctx *ctx, char *response );
+
+/**
+ * @typedef T_lora_nowFp
+ * @brief Monotonic time source
+ *
+ * Returns free running time in milliseconds, wrap around is allowed.
+ */
+typedef uint32_t ( *T_lora_nowFp )( void );
+
+/**
+ * @typedef T_lora_fragFp
+ * @brief Reassembled blob callback
+ *
+ * Called from @link lora_process @endlink when all fragments arrived, blob is
+ * in the buffer given to @link lora_frag_rx_conf @endlink.
+ */
+typedef void ( *T_lora_fragFp )( T_lora_ctx *ctx, uint8_t *blob, uint16_t len );
+
+/**
+ * @typedef T_lora_ringIdx
+ * @brief Receive ring index
+ *
+ * Index must be written by the ISR in a single access, so rings bigger than
+ * 128 bytes should be used only on targets with atomic 16 bit stores.
+ */
+#if LORA_RX_RING_SIZE > 128
+typedef uint16_t T_lora_ringIdx;
+#else
+typedef uint8_t T_lora_ringIdx;
+#endif
+
+/**
+ * @typedef T_lora_fifoIdx
+ * @brief Transmit FIFO index
+ *
+ * Same restriction as for @link T_lora_ringIdx @endlink applies.
+ */
+#if LORA_TX_FIFO_SIZE > 128
+typedef uint16_t T_lora_fifoIdx;
+#else
+typedef uint8_t T_lora_fifoIdx;
+#endif
+
+/**
+ * @struct T_lora_rxStats
+ * @brief Receive path statistics
+ */
+typedef struct
+{
+    uint16_t    overflow;       /**< bytes dropped by ISR because the ring was full */
+    uint16_t    truncated;      /**< bytes dropped because the line was too long */
+    uint16_t    high_water;     /**< maximum number of bytes held by the ring */
+    uint16_t    dropped;        /**< completed lines dropped because the line queue was full */
+
+}T_lora_rxStats;
+
+/**
+ * @struct T_lora_queueStats
+ * @brief Command queue statistics
+ *
+ * Wait time is measured in @link lora_tick_isr @endlink ticks from submission
+ * until the command is written to the module.
+ */
+typedef struct
+{
+    uint8_t     depth;          /**< commands currently waiting */
+    uint8_t     max_depth;      /**< maximum number of waiting commands */
+    uint16_t    rejected;       /**< submissions refused because lane was full */
+    uint32_t    dispatched;     /**< commands written to the module */
+    uint32_t    wait_total;     /**< sum of wait times of dispatched commands */
+    uint32_t    wait_max;       /**< longest wait time */
+
+}T_lora_queueStats;
+
+/**
+ * @struct T_lora_streamStats
+ * @brief Continuous receive statistics
+ *
+ * Dead time is measured in milliseconds from the response closing a receive
+ * window until the module accepts the next radio rx.
+ */
+typedef struct
+{
+    uint32_t    windows;        /**< receive windows opened */
+    uint32_t    frames;         /**< windows closed by radio_rx */
+    uint32_t    errors;         /**< windows closed by radio_err */
+    uint32_t    gap_last;       /**< dead time before the current window */
+    uint32_t    gap_max;        /**< longest dead time */
+    uint32_t    gap_total;      /**< sum of dead times, one per window but the first */
+
+}T_lora_streamStats;
+
+/**
+ * @struct T_lora_fragStats
+ * @brief Reassembly statistics
+ */
+typedef struct
+{
+    uint16_t    blobs;          /**< blobs delivered to the callback */
+    uint16_t    dropped;        /**< blobs given up, too large or replaced by a new one */
+    uint16_t    ignored;        /**< late fragments of a delivered or dropped blob */
+
+}T_lora_fragStats;
+
+/**
+ * @struct T_lora_frame
+ * @brief Frame of a radio tx burst
+ */
+typedef struct
+{
+    const uint8_t*  data;
+    uint16_t        len;
+
+}T_lora_frame;
+
+/**
+ * @struct T_lora_burstStats
+ * @brief Radio tx burst statistics
+ *
+ * Latency is measured in milliseconds from queuing radio tx until
+ * radio_tx_ok, frames per second is frames * 1000 / elapsed.
+ */
+typedef struct
+{
+    uint16_t    frames;         /**< frames reported by radio_tx_ok */
+    uint32_t    elapsed;        /**< burst start until the last radio_tx_ok */
+    uint32_t    lat_last;       /**< latency of the last frame */
+    uint32_t    lat_max;        /**< longest latency */
+    uint32_t    lat_total;      /**< sum of latencies */
+
+}T_lora_burstStats;
+
+/**
+ * @struct T_lora_airtime
+ * @brief Airtime budget state, all times in ms
+ */
+typedef struct
+{
+    uint32_t    total;          /**< airtime of all transmissions since init */
+    uint32_t    frames;         /**< completed transmissions since init */
+    uint32_t    used;           /**< airtime used in the current budget window */
+    uint32_t    left;           /**< budget left in the current window */
+    uint32_t    reset;          /**< time until the window restarts */
+
+}T_lora_airtime;
+
+/**
+ * @struct T_lora_pack
+ * @brief Payload encoder state
+ *
+ * Values are delta encoded against the last acknowledged record. Record
+ * passed to @link lora_pack_encode @endlink becomes reference only after
+ * @link lora_pack_ack @endlink.
+ */
+typedef struct
+{
+    int32_t         ref[ LORA_PACK_FIELDS ];
+    int32_t         pend[ LORA_PACK_FIELDS ];
+    uint8_t         ref_count;
+    uint8_t         pend_count;
+    uint8_t         ref_seq;
+    uint8_t         pend_seq;
+    uint8_t         seq;
+    bool            ref_f;
+
+}T_lora_pack;
+
+/**
+ * @struct T_lora_unpack
+ * @brief Payload decoder state, last decoded records by sequence number
+ */
+typedef struct
+{
+    int32_t         hist[ LORA_PACK_HISTORY ][ LORA_PACK_FIELDS ];
+    uint8_t         hist_seq[ LORA_PACK_HISTORY ];
+    uint8_t         hist_count[ LORA_PACK_HISTORY ];
+    uint8_t         next;
+
+}T_lora_unpack;
+
+/**
+ * Parity header - group number, window size and frame index */
+#define LORA_FEC_HDR                  2
+
+/**
+ * @struct T_lora_fec
+ * @brief Parity encoder state
+ *
+ * Length and payload of every data frame in the group are XOR-ed into the
+ * parity, parity frame is due after window data frames.
+ */
+typedef struct
+{
+    uint8_t         parity[ LORA_FEC_SIZE + 1 ];
+    uint8_t         parity_len;
+    uint8_t         window;
+    uint8_t         group;
+    uint8_t         index;
+
+}T_lora_fec;
+
+/**
+ * @struct T_lora_unfec
+ * @brief Parity decoder state, XOR of all frames received in the group
+ */
+typedef struct
+{
+    uint8_t         acc[ LORA_FEC_SIZE + 1 ];
+    uint16_t        got;
+    uint8_t         window;
+    uint8_t         group;
+    bool            group_f;
+
+}T_lora_unfec;
+
+/**
+ * @brief Downlink view
+ *
+ * Payload of radio_rx or mac_rx response decoded in place inside the receive
+ * storage, no copy is made. View is valid until the next call of
+ * @link lora_process @endlink.
+ */
+typedef struct
+{
+    uint8_t         port;       /**< mac_rx port, 0 for radio_rx */
+    const uint8_t*  data;       /**< payload bytes */
+    uint16_t        len;        /**< payload size, 0 if nothing was received */
+
+}T_lora_downlink;
+
+/**
+ * Transmit Segments - prefix, arguments, separators, header, payload and line end */
+#define LORA_TX_SEG_COUNT             10
+/**
+ * Fragment header - blob id, fragment index and fragment count */
+#define LORA_FRAG_HDR                 3
+
+/**
+ * @struct T_lora_seg
+ * @brief Part of the command streamed to the transmit FIFO
+ */
+typedef struct
+{
+    char*           text;
+    const uint8_t*  data;           /**< payload hex encoded while written */
+    uint16_t        len;            /**< text length or payload bytes */
+
+}T_lora_seg;
+
+/**
+ * @struct T_lora_line
+ * @brief Received line descriptor
+ */
+typedef struct
+{
+    uint16_t        offset;         /**< line start inside the storage */
+    uint16_t        len;            /**< text length */
+    uint16_t        data;           /**< payload start, relative to the line */
+    uint16_t        data_len;       /**< decoded payload bytes */
+    uint8_t         port;           /**< mac_rx port number */
+    uint8_t         rsp;            /**< T_lora_rsp class of the keyword */
+    bool            hex_f;          /**< payload holds binary, text not restored */
+
+}T_lora_line;
+
+/**
+ * @struct T_lora_cmd
+ * @brief Queued command
+ */
+typedef struct
+{
+    char*           prefix;
+    char*           arg1;
+    char*           arg2;
+    char*           arg3;
+    const uint8_t*  data;           /**< binary payload, hex encoded on send */
+    uint16_t        data_len;
+    uint8_t         port;           /**< binary mac tx port, 0 if not used */
+    uint8_t         head[ LORA_FRAG_HDR ];  /**< binary header sent before data */
+    uint8_t         head_len;
+    char*           response;
+    T_lora_downlink* downlink;
+    T_lora_doneFp   done;
+    uint8_t         rsp_count;
+    uint32_t        queued;
+    uint32_t        timeout;        /**< ms from transmission, 0 waits forever */
+    uint16_t        air_len;        /**< PHY payload of transmissions, 0 if nothing is sent */
+
+}T_lora_cmd;
+
+/**
+ * @struct T_lora_ctx
+ * @brief Driver context
+ *
+ * Holds buffers, state and HAL objects of one module so several modules can
+ * be driven from the same firmware, each on its own UART. Context is
+ * allocated by the user and must not be accessed directly.
+ */
+struct T_lora_ctx
+{
+    /* HAL objects, mapped before the context touches the hardware */
+    T_LORA_P                gpio;
+    T_LORA_P                bus;
+
+    /* Line Storage */
+    char                    rx_buffer[ LORA_RX_STORE_SIZE ];
+    uint16_t                rx_buffer_len;
+    uint16_t                rx_line_start;
+
+    /* Transmit FIFO - lora_tx_isr or lora_process is the only consumer */
+    volatile char           tx_fifo[ LORA_TX_FIFO_SIZE ];
+    volatile T_lora_fifoIdx tx_head;
+    volatile T_lora_fifoIdx tx_tail;
+
+    /* Transmit Segments - command is streamed from these, never assembled */
+    T_lora_seg              tx_seg[ LORA_TX_SEG_COUNT ];
+    uint8_t                 tx_seg_count;
+    uint8_t                 tx_seg_cur;
+    uint16_t                tx_seg_pos;
+    uint16_t                tx_len;
+    char                    tx_port[ 4 ];
+    uint8_t                 tx_hdr[ LORA_FRAG_HDR ];
+
+    /* Receive Ring - ISR is the only producer, lora_process the only consumer */
+    volatile char           rx_ring[ LORA_RX_RING_SIZE ];
+    volatile T_lora_ringIdx rx_head;
+    volatile T_lora_ringIdx rx_tail;
+    volatile uint16_t       rx_overflow;
+    volatile uint16_t       rx_high_water;
+    uint16_t                rx_truncated;
+
+    /* Completed Lines - filled by framing, drained by lora_process */
+    T_lora_line             rx_lines[ LORA_RX_LINE_COUNT ];
+    uint8_t                 line_head;
+    uint8_t                 line_tail;
+    bool                    line_busy_f;
+
+    /* Streaming Parser - state of the line being framed */
+    T_lora_line             rx_cur;
+    uint8_t                 par_state;
+    uint8_t                 par_nibble;
+    uint16_t                line_dropped;
+
+    /* Timer Flags and Deadline of the command in flight */
+    volatile bool           timer_f;
+    volatile bool           timeout_f;
+    volatile bool           timer_use_f;
+    volatile uint32_t       clock;
+    volatile uint32_t       deadline;
+    uint32_t                cmd_timeout;
+    T_lora_nowFp            now;
+
+    /* Command Engine */
+    uint8_t                 cmd_state;
+    uint8_t                 cmd_rsp_count;
+    T_lora_doneFp           cmd_done;
+
+    /* Command Queue - one ring per lane, urgent lane is always served first */
+    T_lora_cmd              cmd_queue[ LORA_LANE_COUNT ][ LORA_CMD_QUEUE_SIZE ];
+    uint8_t                 cmd_head[ LORA_LANE_COUNT ];
+    uint8_t                 cmd_tail[ LORA_LANE_COUNT ];
+    T_lora_queueStats       cmd_stats[ LORA_LANE_COUNT ];
+
+#if LORA_USE_DUTY
+    /* Duty Cycle - time each sub-band becomes free again */
+    uint8_t                 dc_mask;
+    uint32_t                dc_free[ LORA_BAND_COUNT ];
+#endif
+
+    /* Airtime - radio settings, frame in flight and budget window */
+    uint8_t                 air_sf;
+    uint16_t                air_bw;
+    uint8_t                 air_cr;
+    uint16_t                air_len;
+    uint32_t                air_period;
+    uint32_t                air_budget;
+    uint32_t                air_start;
+    uint32_t                air_used;
+    uint32_t                air_total;
+    uint32_t                air_frames;
+
+#if LORA_USE_AGG
+    /* Uplink Aggregation - records collect in one buffer while the other is sent */
+    uint8_t                 agg_buf[ 2 ][ LORA_AGG_SIZE ];
+    uint8_t                 agg_len[ 2 ];
+    uint8_t                 agg_fill;
+    uint8_t                 agg_port;
+    uint8_t                 agg_lane;
+    bool                    agg_confirmed;
+    bool                    agg_send_f;
+    bool                    agg_flush_f;
+    uint32_t                agg_first;
+    uint32_t                agg_age;
+    T_lora_doneFp           agg_done;
+#endif
+
+#if LORA_USE_FRAG
+    /* Fragmentation - blob being sent, one fragment in the queue at a time */
+    const uint8_t*          frag_data;
+    uint16_t                frag_len;
+    uint16_t                frag_size;
+    uint8_t                 frag_port;
+    uint8_t                 frag_id;
+    uint8_t                 frag_index;
+    uint8_t                 frag_count;
+    bool                    frag_confirmed;
+    bool                    frag_send_f;
+    T_lora_doneFp           frag_done;
+
+    /* Reassembly - downlink fragments collected into the user buffer */
+    uint8_t*                frag_rx_buf;
+    uint16_t                frag_rx_size;
+    uint16_t                frag_rx_fsize;
+    uint16_t                frag_rx_total;
+    uint16_t                frag_rx_tail;
+    uint8_t                 frag_rx_port;
+    uint8_t                 frag_rx_id;
+    uint8_t                 frag_rx_count;
+    uint8_t                 frag_rx_got;
+    uint8_t                 frag_rx_map[ LORA_FRAG_MAX / 8 ];
+    uint8_t                 frag_rx_last;
+    bool                    frag_rx_last_f;
+    T_lora_fragFp           frag_rx_done;
+    T_lora_fragStats        frag_rx_stats;
+#endif
+
+#if LORA_USE_STREAM
+    /* Continuous Receive - radio rx re-armed from its own completion */
+    bool                    stream_f;
+    bool                    stream_arm_f;
+    bool                    stream_stop_f;
+    bool                    stream_open_f;
+    bool                    stream_end_f;
+    uint32_t                stream_end;
+    T_lora_downlink*        stream_downlink;
+    T_lora_doneFp           stream_done;
+    T_lora_streamStats      stream_stats;
+#endif
+
+#if LORA_USE_BURST
+    /* Radio Burst - frame table being sent, next frame queued on radio_tx_ok */
+    const T_lora_frame*     burst_frames;
+    uint16_t                burst_count;
+    uint16_t                burst_index;
+    uint8_t                 burst_lane;
+    bool                    burst_send_f;
+    uint32_t                burst_start;
+    uint32_t                burst_queued;
+    T_lora_doneFp           burst_done;
+    T_lora_burstStats       burst_stats;
+#endif
+
+    /* Blocking Calls */
+    volatile bool           block_f;
+    uint8_t                 block_status;
+
+    /* Response vars */
+    char*                   rsp_buffer;
+    T_lora_downlink*        rsp_downlink;
+    bool                    callback_default;
+    T_lora_rspFp            callback_resp;
+};
+
                                                                        /** @} */
 #ifdef __cplusplus
 extern "C"{
@@ -73,17 +671,95 @@ extern "C"{
 /** @defgroup LORA_INIT Driver Initialization */              /** @{ */
 
 #ifdef   __LORA_DRV_SPI__
-void lora_spiDriverInit(T_LORA_P gpioObj, T_LORA_P spiObj);
+void lora_spiDriverInit(T_lora_ctx *ctx, T_LORA_P gpioObj, T_LORA_P spiObj);
 #endif
 #ifdef   __LORA_DRV_I2C__
-void lora_i2cDriverInit(T_LORA_P gpioObj, T_LORA_P i2cObj, uint8_t slave);
+void lora_i2cDriverInit(T_lora_ctx *ctx, T_LORA_P gpioObj, T_LORA_P i2cObj, uint8_t slave);
 #endif
 #ifdef   __LORA_DRV_UART__
-void lora_uartDriverInit(T_LORA_P gpioObj, T_LORA_P uartObj);
+void lora_uartDriverInit(T_lora_ctx *ctx, T_LORA_P gpioObj, T_LORA_P uartObj);
 #endif
 
 // GPIO Only Drivers - remove in other cases
-void lora_gpioDriverInit(T_LORA_P gpioObj);
+void lora_gpioDriverInit(T_lora_ctx *ctx, T_LORA_P gpioObj);
+
+#ifdef   __linux__
+/**
+ * @brief Linux Host Objects
+ *
+ * UART and GPIO objects for @link lora_uartDriverInit @endlink when the
+ * driver runs on a Linux host. UART is opened on tty or pty device, GPIO
+ * object ignores reset and reports INT pin as low.
+ *
+ * @note
+ * hal_linuxUartWait blocks until data arrives or timeout expires, it can be
+ * used instead of busy polling between @link lora_process @endlink calls.
+ *
+ * @param[in] path - device path ( /dev/ttyUSB0, /dev/pts/N )
+ * @param[in] baud - baud rate, 57600 for RN2483, one of 9600, 19200, 38400,
+ * 57600, 115200 or 230400
+ *
+ * @return UART object or 0 on error, errno is EINVAL for unsupported baud rate
+ */
+T_LORA_P hal_linuxUartOpen( const char *path, uint32_t baud );
+int hal_linuxUartWait( T_LORA_P uartObj, int timeout_ms );
+T_LORA_P hal_linuxGpio();
+#endif
+
+#ifdef   __HAL_SIM__
+/**
+ * @brief Simulated Module Configuration
+ *
+ * All times are in microseconds of simulated time. Error and downlink rates
+ * are in percent, same seed always gives the same sequence of responses.
+ */
+typedef struct
+{
+    uint32_t    rsp_delay;          /**< first response after the command */
+    uint32_t    airtime;            /**< transmission time of tx and join */
+    uint32_t    rx_delay;           /**< receive window after transmission */
+    uint32_t    step;               /**< time consumed by every UART poll */
+    uint32_t    seed;               /**< error and payload generator seed */
+    uint8_t     error_rate;         /**< commands answered with an error */
+    uint8_t     downlink_rate;      /**< mac tx answered with mac_rx */
+    uint8_t     rx_size;            /**< bytes in received frames */
+
+}T_hal_simCfg;
+
+/**
+ * @brief Simulated Module Counters
+ */
+typedef struct
+{
+    uint32_t    commands;           /**< command lines received */
+    uint32_t    responses;          /**< response lines delivered */
+    uint32_t    tx_bytes;           /**< payload bytes transmitted */
+    uint32_t    dropped;            /**< responses lost, pending queue was full */
+
+}T_hal_simStats;
+
+/**
+ * @brief Simulated Module Objects
+ *
+ * UART and GPIO objects for @link lora_uartDriverInit @endlink when the
+ * driver is compiled with __HAL_SIM__. Module answers sys get ver, mac pause,
+ * radio set, radio tx / rx, mac tx and mac join commands on its own clock.
+ *
+ * @note
+ * Every UART poll advances the clock by the configured step, so blocking
+ * calls finish without outside help. hal_simAdvance moves the clock directly,
+ * hal_simNow gives simulated time for latency measurement.
+ *
+ * @param[in] cfg - module timing and error injection
+ *
+ * @return UART object or 0 when all modules are in use
+ */
+T_LORA_P hal_simOpen( const T_hal_simCfg *cfg );
+void hal_simAdvance( T_LORA_P uartObj, uint32_t time_us );
+uint32_t hal_simNow( T_LORA_P uartObj );
+void hal_simStats( T_LORA_P uartObj, T_hal_simStats *stats );
+T_LORA_P hal_simGpio();
+#endif
                                                                        /** @} */
 /** @defgroup LORA_FUNC Driver Functions */                   /** @{ */
 
@@ -96,39 +772,90 @@ void lora_gpioDriverInit(T_LORA_P gpioObj);
  * @note Module restart issues the response from the module with current
  * firmware version.
  *
+ * @param[in] ctx - driver context, previously passed to driver init
  * @param[in] - pointer to user made callback function that receiving response
- *      as argument and will be executed one every response
+ *      as argument and will be executed on every line which arrives while no
+ *      command is waiting for response
  *
  */
-void lora_init(bool CB_default, void ( *response_p )( char *response ));
+void lora_init(T_lora_ctx *ctx, bool CB_default, T_lora_rspFp response_p);
 /**
  * @brief Main Process
  *
- * Function must be placed inside the infinite while loop.
+ * Function must be placed inside the infinite while loop, once for every
+ * context.
  */
-void lora_process();
+void lora_process( T_lora_ctx *ctx );
 /**
  * @brief Receiver
  *
- * Must be placed inside the user made uart interrupt routine.
+ * Must be placed inside the user made uart interrupt routine. Received byte is
+ * only stored to the receive ring, lines are assembled later by
+ * @link lora_process @endlink.
+ *
+ * @note
+ * Receive ring has a single producer. HAL compiled with __HAL_UART_RX_IRQ__
+ * leaves receiving to this routine, without it @link lora_process @endlink
+ * polls the UART itself and the receive interrupt must not be enabled.
  *
  * @param[in] rx_input - data from uart receive register
  */
-void lora_rx_isr( char rx_input );
+void lora_rx_isr( T_lora_ctx *ctx, char rx_input );
+/**
+ * @brief Transmitter
+ *
+ * Must be placed inside the user made uart transmit register empty interrupt
+ * routine when HAL is compiled with __HAL_UART_TX_IRQ__. Sends next byte from
+ * the transmit FIFO and disables the interrupt when FIFO becomes empty.
+ *
+ * @note
+ * Without transmit interrupt FIFO is drained by @link lora_process @endlink,
+ * one byte per call. Command longer than the FIFO is written in parts, each
+ * @link lora_process @endlink call refills the FIFO as it drains. HAL keeps a
+ * single UART mapping, so with more than one context transmit interrupt must
+ * not be used.
+ */
+void lora_tx_isr( T_lora_ctx *ctx );
+/**
+ * @brief Receiver Statistics
+ *
+ * Counters are free running and never cleared by the driver.
+ *
+ * @param[out] stats - receive path statistics
+ */
+void lora_rx_stats( T_lora_ctx *ctx, T_lora_rxStats *stats );
+/**
+ * @brief Response Code
+ *
+ * Classifies a module line by its first word with the same keyword lookup
+ * used by the receiver.
+ *
+ * @param[in] line - response text, keyword ends with space, line end or '\0'
+ * @retval T_lora_rsp code, LORA_RSP_OTHER when line is not a response keyword
+ */
+uint8_t lora_rsp_code( char *line );
 /**
  * @brief Timer
  *
  * Used for host timing. Should be placed inside the previously made interrupt
  * routine made by user that occurs on every one milisecond.
  */
-void lora_tick_isr();
+void lora_tick_isr( T_lora_ctx *ctx );
 /**
  * @brief Timer Configuration
  *
- * Used to configure host watchdog. When timeout occurs response with no data
- * will be parsed. If user provide 0 as argument timer will be turned off. By
- * default after the initialization timer limit is turned on and set to
- * @link TIMER_EXPIRED @endlink
+ * Used to configure host watchdog. Every command gets its own deadline when it
+ * is sent, if the final response does not arrive in time command completes
+ * with LORA_RSP_TIMEOUT. If user provide 0 as argument timer will be turned
+ * off, by default after the initialization timer is turned off.
+ *
+ * Limit is the deadline of commands sent with @link lora_cmd @endlink, radio
+ * commands use @link LORA_TIMEOUT_RADIO @endlink and mac tx / join
+ * @link LORA_TIMEOUT_MAC @endlink. Continuous radio rx ( window 0 ) has no
+ * deadline.
+ * Command that times out while it is still being written is cut, the line is
+ * terminated so the module refuses it and the next command waits for that
+ * refusal.
  *
  * @note
  * RN2483 have it's own watchdog timer, this one should be longer than watchdog
@@ -137,7 +864,29 @@ void lora_tick_isr();
  *
  * @param[in] timer_limit ( 0 ~ 4294967296 )
  */
-void lora_tick_conf( uint32_t timer_limit );
+void lora_tick_conf( T_lora_ctx *ctx, uint32_t timer_limit );
+/**
+ * @brief Tickless Timing
+ *
+ * Replaces @link lora_tick_isr @endlink with the time source provided by the
+ * application ( RTC, free running timer ). Time is read when commands are
+ * queued and sent and deadlines are checked by @link lora_process @endlink,
+ * so no periodic interrupt is needed. Watchdog is still enabled with
+ * @link lora_tick_conf @endlink.
+ *
+ * @param[in] now - monotonic millisecond time source, 0 returns to tick mode
+ */
+void lora_time_conf( T_lora_ctx *ctx, T_lora_nowFp now );
+/**
+ * @brief Time To Deadline
+ *
+ * Lets the application sleep between radio events - MCU can wake up on
+ * UART activity or after the returned time, whichever comes first.
+ *
+ * @return ms until the deadline of the command in flight, 0 if already
+ * expired, 0xFFFFFFFF if there is no deadline
+ */
+uint32_t lora_time_left( T_lora_ctx *ctx );
 /**
  * @brief Sender
  *
@@ -150,12 +899,399 @@ void lora_tick_conf( uint32_t timer_limit );
  * @param[in] buffer - data buffer if needed
  * @param[in] count - size of data
  */
-void lora_cmd(uint8_t *cmd,  char *response);
-uint8_t lora_mac_tx(char* payload, char* port_no, char *buffer, char *response);
-uint8_t lora_join(char* join_mode, char *response);
-uint8_t lora_rx(char* window_size, char *response);
-uint8_t lora_tx( char *buffer );
-char lora_rxData();
+void lora_cmd(T_lora_ctx *ctx, char *cmd,  char *response);
+/**
+ * @brief MAC Transmit
+ *
+ * Blocks until the second response. Returns 12 when the uplink was followed
+ * by a downlink, downlink line is placed in the response buffer.
+ */
+uint8_t lora_mac_tx(T_lora_ctx *ctx, char* payload, char* port_no, char *buffer, char *response);
+uint8_t lora_join(T_lora_ctx *ctx, char* join_mode, char *response);
+uint8_t lora_rx(T_lora_ctx *ctx, char* window_size, char *response);
+uint8_t lora_tx( T_lora_ctx *ctx, char *buffer );
+
+/**
+ * @brief Asynchronous Commands
+ *
+ * Same commands as above which return immediately. Command is placed in the
+ * command queue and written to the module by @link lora_process @endlink as
+ * soon as the previous command completes, urgent lane is always served first.
+ * Callback is executed once the final response arrives or the host timer
+ * expires. Function returns false if the lane is full.
+ *
+ * @note
+ * Argument strings are not copied, they must stay valid until the callback.
+ * Blocking functions are wrappers around these using normal lane and must
+ * not be called from the completion callback.
+ *
+ * @param[in] lane - LORA_LANE_NORMAL or LORA_LANE_URGENT
+ */
+bool lora_cmd_async(T_lora_ctx *ctx, char *cmd, T_lora_doneFp done);
+bool lora_mac_tx_async(T_lora_ctx *ctx, char* payload, char* port_no, char *buffer, uint8_t lane, T_lora_doneFp done);
+bool lora_join_async(T_lora_ctx *ctx, char* join_mode, T_lora_doneFp done);
+bool lora_rx_async(T_lora_ctx *ctx, char* window_size, T_lora_doneFp done);
+bool lora_tx_async( T_lora_ctx *ctx, char *buffer, uint8_t lane, T_lora_doneFp done );
+/**
+ * @brief Binary Transfer
+ *
+ * Payload is given as raw bytes and hex encoded by the driver straight into
+ * the transmit FIFO while the command is written, no ASCII copy is needed.
+ * Downlink is delivered through the view instead of the response string,
+ * callback of asynchronous variant receives empty response in that case.
+ *
+ * @note
+ * Payload is not copied, it must stay valid until the callback.
+ *
+ * @param[in] port - application port ( 1 ~ 223 )
+ * @param[in] data - payload bytes
+ * @param[in] len - payload size
+ * @param[in] confirmed - confirmed or unconfirmed uplink
+ * @param[out] downlink - received payload, can be 0
+ */
+uint8_t lora_mac_tx_bin( T_lora_ctx *ctx, uint8_t port, const uint8_t *data, uint16_t len, bool confirmed, T_lora_downlink *downlink );
+uint8_t lora_rx_bin( T_lora_ctx *ctx, char* window_size, T_lora_downlink *downlink );
+uint8_t lora_tx_bin( T_lora_ctx *ctx, const uint8_t *data, uint16_t len );
+bool lora_mac_tx_bin_async( T_lora_ctx *ctx, uint8_t port, const uint8_t *data, uint16_t len, bool confirmed, T_lora_downlink *downlink, uint8_t lane, T_lora_doneFp done );
+bool lora_rx_bin_async( T_lora_ctx *ctx, char* window_size, T_lora_downlink *downlink, T_lora_doneFp done );
+bool lora_tx_bin_async( T_lora_ctx *ctx, const uint8_t *data, uint16_t len, uint8_t lane, T_lora_doneFp done );
+/**
+ * @brief Command Queue Statistics
+ *
+ * @param[in] lane - LORA_LANE_NORMAL or LORA_LANE_URGENT
+ * @param[out] stats - lane statistics
+ */
+void lora_queue_stats( T_lora_ctx *ctx, uint8_t lane, T_lora_queueStats *stats );
+#if LORA_USE_STREAM
+/**
+ * @brief Continuous Receive
+ *
+ * Driver issues radio rx 0 and queues the next one as soon as the window is
+ * closed by radio_rx or radio_err, every window is reported to the callback
+ * with the payload in the downlink view. Commands queued from the callback
+ * go out before the receiver is re-armed.
+ *
+ * @note
+ * mac pause and radio set wdt 0 must be issued once before. Stream stops by
+ * itself when the module refuses radio rx.
+ *
+ * @param[out] downlink - received payload, can be 0
+ * @param[in] done - called with every closed window
+ *
+ * @return false if stream is already running
+ */
+bool lora_rx_stream( T_lora_ctx *ctx, T_lora_downlink *downlink, T_lora_doneFp done );
+/**
+ * @brief Stop Continuous Receive
+ *
+ * Receiver is not re-armed. Window already open is closed with radio rxstop
+ * and reported with LORA_RSP_ABORTED, same as a window still in the queue.
+ */
+void lora_rx_stream_stop( T_lora_ctx *ctx );
+/**
+ * @brief Continuous Receive Statistics
+ *
+ * @param[out] stats - windows, frames and dead time between windows
+ */
+void lora_rx_stream_stats( T_lora_ctx *ctx, T_lora_streamStats *stats );
+#endif
+#if LORA_USE_BURST
+/**
+ * @brief Radio Transmit Burst
+ *
+ * Frames are sent back to back with binary radio tx, next frame is queued
+ * the moment radio_tx_ok of the previous one is parsed, application is not
+ * involved between frames.
+ *
+ * @note
+ * Frame table and payloads are not copied, they must stay valid until the
+ * callback. Burst stops at the first failed frame and reports its status.
+ *
+ * @param[in] frames - frame table
+ * @param[in] count - number of frames
+ * @param[in] lane - LORA_LANE_NORMAL or LORA_LANE_URGENT
+ * @param[in] done - called when all frames are sent or burst failed
+ *
+ * @return false if another burst is running or table is empty
+ */
+bool lora_tx_burst( T_lora_ctx *ctx, const T_lora_frame *frames, uint16_t count, uint8_t lane, T_lora_doneFp done );
+/**
+ * @brief Radio Transmit Burst Statistics
+ *
+ * @param[out] stats - frames sent, elapsed time and per frame latency
+ */
+void lora_tx_burst_stats( T_lora_ctx *ctx, T_lora_burstStats *stats );
+#endif
+/**
+ * @brief Time On Air
+ *
+ * Integer only, symbol time is taken from a table. Explicit header, CRC on,
+ * 8 symbol preamble and low data rate optimization when symbol is 16 ms or
+ * longer, as used by RN2483.
+ *
+ * @param[in] sf - spreading factor ( 7 ~ 12 )
+ * @param[in] bw - bandwidth in kHz ( 125, 250, 500 )
+ * @param[in] cr - coding rate denominator ( 5 ~ 8 for 4/5 ~ 4/8 )
+ * @param[in] len - PHY payload size, LoRaWAN adds 13 bytes to application data
+ *
+ * @return airtime in ms, 0 for unsupported spreading factor
+ */
+uint32_t lora_toa( uint8_t sf, uint16_t bw, uint8_t cr, uint16_t len );
+/**
+ * @brief Airtime Configuration
+ *
+ * Radio settings used for airtime of transmissions, must follow the
+ * mac set dr / radio set sf, bw, cr commands sent to the module. Default is
+ * SF7, 125 kHz, 4/5.
+ */
+void lora_airtime_conf( T_lora_ctx *ctx, uint8_t sf, uint16_t bw, uint8_t cr );
+/**
+ * @brief Airtime Budget
+ *
+ * Every transmission the module accepted with ok adds its airtime to the
+ * budget window when it completes ( mac_tx_ok, mac_rx, mac_err, radio_tx_ok,
+ * radio_err, join answer ). Budget is advisory,
+ * transmissions are not held when it is exhausted.
+ *
+ * @param[in] period - window length in ms, 0 for a window that never restarts
+ * @param[in] budget - airtime allowed in the window in ms, 0 for no limit
+ */
+void lora_airtime_budget( T_lora_ctx *ctx, uint32_t period, uint32_t budget );
+/**
+ * @brief Airtime Statistics
+ *
+ * @param[out] stats - budget state
+ */
+void lora_airtime_stats( T_lora_ctx *ctx, T_lora_airtime *stats );
+/**
+ * @brief Airtime Check
+ *
+ * @param[in] len - PHY payload size
+ *
+ * @return true if frame fits into the budget left in the current window
+ */
+bool lora_airtime_fits( T_lora_ctx *ctx, uint16_t len );
+/**
+ * @brief Maximum Payload
+ *
+ * @return EU868 application payload limit at the @link lora_airtime_conf @endlink
+ * spreading factor ( 51, 115 or 222 bytes )
+ */
+uint8_t lora_max_payload( T_lora_ctx *ctx );
+#if LORA_USE_AGG
+/**
+ * @brief Uplink Aggregation
+ *
+ * Records added with @link lora_agg_add @endlink are packed into one frame,
+ * each preceded by its length byte. Frame is sent with binary mac tx when
+ * the next record does not fit into @link lora_max_payload @endlink, when the
+ * oldest record reaches the maximum age or when an urgent record is added.
+ * One frame can be collected while the previous one is being sent.
+ *
+ * @param[in] port - application port ( 1 ~ 223 ), 0 turns aggregation off
+ * @param[in] confirmed - confirmed or unconfirmed uplinks
+ * @param[in] max_age - ms the first record may wait, 0 for no limit
+ * @param[in] done - called with the status of every sent frame, can be 0
+ */
+void lora_agg_conf( T_lora_ctx *ctx, uint8_t port, bool confirmed, uint32_t max_age, T_lora_doneFp done );
+/**
+ * @brief Add Record
+ *
+ * Record is copied, frame goes through the urgent lane when urgent is set.
+ *
+ * @param[in] record - record bytes
+ * @param[in] len - record size
+ * @param[in] urgent - send the frame right after this record
+ *
+ * @return false if the record is larger than a frame or both buffers are busy
+ */
+bool lora_agg_add( T_lora_ctx *ctx, const uint8_t *record, uint8_t len, bool urgent );
+/**
+ * @brief Flush Records
+ *
+ * Sends the records collected so far as soon as the previous frame is out.
+ */
+void lora_agg_flush( T_lora_ctx *ctx );
+#endif
+#if LORA_USE_FRAG
+/**
+ * @brief Fragmented Send
+ *
+ * Blob larger than one frame is split into fragments of
+ * @link lora_max_payload @endlink less the 3 byte header ( blob id, fragment
+ * index, fragment count ) and sent with binary mac tx, next fragment is
+ * queued when the previous one is out, so other commands and duty cycle are
+ * respected between them.
+ *
+ * @note
+ * Blob is not copied, it must stay valid until the callback. Transfer stops
+ * at the first failed fragment and reports its status.
+ *
+ * @param[in] port - application port ( 1 ~ 223 )
+ * @param[in] blob - data to send
+ * @param[in] len - blob size, up to 255 fragments
+ * @param[in] confirmed - confirmed or unconfirmed uplinks
+ * @param[in] done - called when the whole blob is sent or transfer failed
+ *
+ * @return false if another blob is being sent or blob is too large
+ */
+bool lora_frag_send( T_lora_ctx *ctx, uint8_t port, const uint8_t *blob, uint16_t len, bool confirmed, T_lora_doneFp done );
+/**
+ * @brief Reassembly Configuration
+ *
+ * Fragments received as mac_rx on the port ( radio_rx for port 0 ) are put
+ * in place inside the buffer, fragments may arrive out of order. Last
+ * fragment received before any other is kept at the end of the buffer until
+ * the fragment size is known. Blob with a new id drops the incomplete one,
+ * blob that does not fit the buffer is dropped as soon as that is known.
+ * Fragments repeating the id of the last delivered or dropped blob are
+ * ignored. Downlinks are still delivered as usual.
+ *
+ * @param[in] port - downlink port, 0 for radio_rx
+ * @param[in] buf - reassembly buffer, 0 turns reassembly off
+ * @param[in] size - buffer size, larger blobs are dropped
+ * @param[in] done - called with every complete blob
+ */
+void lora_frag_rx_conf( T_lora_ctx *ctx, uint8_t port, uint8_t *buf, uint16_t size, T_lora_fragFp done );
+/**
+ * @brief Reassembly Statistics
+ *
+ * @param[out] stats - delivered and dropped blobs, ignored fragments
+ */
+void lora_frag_rx_stats( T_lora_ctx *ctx, T_lora_fragStats *stats );
+#endif
+/**
+ * @brief Payload Encoder
+ *
+ * Record of integer values is packed as zigzag varints, as difference to the
+ * reference record when encoder has one with the same number of values.
+ * Optional LZ pass is kept only when it makes the record shorter. Frame
+ * starts with sequence number, flags and value count and reference sequence
+ * number for delta records.
+ *
+ * @note
+ * Same functions decode on the receiving side, driver builds on hosts.
+ *
+ * @param[in] values - record values
+ * @param[in] count - number of values ( 1 ~ LORA_PACK_FIELDS, at most 63 ),
+ * value takes up to 5 bytes so record longer than the room is refused unless
+ * LZ pass shortens it
+ * @param[in] lz - try LZ pass
+ * @param[out] out - encoded frame
+ * @param[in] size - room in out
+ *
+ * @return frame size, 0 if it does not fit
+ */
+void lora_pack_init( T_lora_pack *pack );
+uint8_t lora_pack_encode( T_lora_pack *pack, const int32_t *values, uint8_t count, bool lz, uint8_t *out, uint8_t size );
+/**
+ * @brief Acknowledge Encoded Record
+ *
+ * Last encoded record becomes the delta reference. Should be called when the
+ * frame is acknowledged ( confirmed uplink ) or known to be received.
+ */
+void lora_pack_ack( T_lora_pack *pack );
+/**
+ * @brief Payload Decoder
+ *
+ * @param[in] in - encoded frame
+ * @param[in] len - frame size
+ * @param[out] values - decoded values, room for LORA_PACK_FIELDS
+ *
+ * @return number of values, 0 if frame is malformed or its reference is not
+ * in the decoder history
+ */
+void lora_unpack_init( T_lora_unpack *unpack );
+uint8_t lora_pack_decode( T_lora_unpack *unpack, const uint8_t *in, uint16_t len, int32_t *values );
+/**
+ * @brief LZ Codec
+ *
+ * Tiny window ( 32 bytes ) LZ77, one control byte per eight literals or
+ * matches, match is one byte of offset and length ( 3 ~ 10 ).
+ *
+ * @return output size, 0 if output does not fit or input is malformed
+ */
+uint16_t lora_lz_encode( const uint8_t *in, uint16_t len, uint8_t *out, uint16_t size );
+uint16_t lora_lz_decode( const uint8_t *in, uint16_t len, uint8_t *out, uint16_t size );
+/**
+ * @brief Parity Encoder
+ *
+ * Frames for radio tx get the 2 byte header, after every window data frames
+ * @link lora_fec_parity @endlink returns the parity frame. Receiver rebuilds
+ * any single frame lost inside the group without a retransmission.
+ *
+ * @note
+ * Airtime grows by one frame per window, largest frame of the group sets the
+ * parity size. Same functions decode on the receiving side.
+ *
+ * @param[in] window - data frames per parity frame ( 1 ~ 15 )
+ * @param[in] data - payload
+ * @param[in] len - payload size ( up to LORA_FEC_SIZE )
+ * @param[out] out - frame, room for len + LORA_FEC_HDR
+ *
+ * @return frame size, 0 if payload is too large or parity frame of the
+ * complete group was not taken yet
+ */
+void lora_fec_init( T_lora_fec *fec, uint8_t window );
+uint8_t lora_fec_encode( T_lora_fec *fec, const uint8_t *data, uint8_t len, uint8_t *out );
+/**
+ * @brief Parity Frame
+ *
+ * @param[out] out - frame, room for LORA_FEC_SIZE + 1 + LORA_FEC_HDR
+ *
+ * @return frame size, 0 if group is not complete yet
+ */
+uint8_t lora_fec_parity( T_lora_fec *fec, uint8_t *out );
+/**
+ * @brief Parity Decoder
+ *
+ * Every received frame is passed here, frame of a new group drops the state
+ * of the previous one.
+ *
+ * @param[in] in - received frame
+ * @param[in] len - frame size
+ *
+ * @return payload size of a data frame, payload starts at in + LORA_FEC_HDR,
+ * 0 for parity, duplicate or malformed frames
+ */
+void lora_unfec_init( T_lora_unfec *fec );
+uint8_t lora_fec_decode( T_lora_unfec *fec, const uint8_t *in, uint8_t len );
+/**
+ * @brief Lost Frame Recovery
+ *
+ * Should be called after every @link lora_fec_decode @endlink, succeeds once
+ * per group when parity and all data frames but one were received.
+ *
+ * @param[out] out - recovered payload, room for LORA_FEC_SIZE
+ * @param[out] index - position of the recovered frame in the group
+ *
+ * @return payload size, 0 if nothing can be recovered
+ */
+uint8_t lora_fec_recover( T_lora_unfec *fec, uint8_t *out, uint8_t *index );
+#if LORA_USE_DUTY
+/**
+ * @brief Duty Cycle Scheduler
+ *
+ * Airtime of every accepted mac tx, mac join and radio tx is computed with
+ * @link lora_toa @endlink at the @link lora_airtime_conf @endlink settings and
+ * charged to a free sub-band among the ones holding enabled channels.
+ * Transmission at the head of a lane is held in the queue until one of those
+ * sub-bands is free again, so module never answers no_free_ch.
+ *
+ * @note
+ * Needs @link lora_tick_isr @endlink or @link lora_time_conf @endlink time.
+ * Commands behind a held uplink wait in the same lane, urgent lane passes it.
+ *
+ * @param[in] band_mask - LORA_BAND_xx of enabled channels, 0 turns scheduler off
+ */
+void lora_duty_conf( T_lora_ctx *ctx, uint8_t band_mask );
+/**
+ * @brief Duty Cycle Wait
+ *
+ * @return ms until the next uplink may be sent, 0 if a sub-band is free
+ */
+uint32_t lora_duty_wait( T_lora_ctx *ctx );
+#endif
 
 
 
@@ -46,6 +46,8 @@
 //                #define   __HAL_SPI__                            /**<     @macro __HAL_SPI__  @brief SPI HAL selector */                
 //                #define   __HAL_I2C__                            /**<     @macro __HAL_I2C__  @brief I2C HAL selector */
                 #define   __HAL_UART__                           /**<     @macro __HAL_UART__  @brief UART HAL selector */                          
+//                #define   __HAL_UART_TX_IRQ__                    /**<     @macro __HAL_UART_TX_IRQ__  @brief UART transmit interrupt selector */
+//                #define   __HAL_UART_RX_IRQ__                    /**<     @macro __HAL_UART_RX_IRQ__  @brief UART receive interrupt selector, lora_process stops polling */
 
 // #define   __AN_PIN_INPUT__          0
 // #define   __RST_PIN_INPUT__         1
@@ -210,6 +212,17 @@ static void hal_uartMap(T_HAL_P uartObj);
  */
 static void hal_uartWrite(uint8_t input);
 
+#ifdef __HAL_UART_TX_IRQ__
+/**
+ * @brief hal_uartTxIrq
+ *
+ * @param[in] state 1 to enable, 0 to disable interrupt
+ *
+ * Function enables or disables transmit register empty interrupt.
+ */
+static void hal_uartTxIrq(uint8_t state);
+#endif
+
 /**
  * @brief hal_uartRead
  *
@@ -396,6 +409,10 @@ static void hal_gpioMap(T_HAL_P gpioObj)
 #endif
 }
                                                                        /** @} */
+#ifdef __HAL_SIM__
+#include "__HAL_SIM.c"
+#else
+
 #ifdef __MIKROC_PRO_FOR_PIC__
 #include "__HAL_PIC.c"
 #endif
@@ -448,6 +465,12 @@ static void hal_gpioMap(T_HAL_P gpioObj)
 #endif
 #endif
 
+#ifdef __linux__
+#include "__HAL_LINUX.c"
+#endif
+
+#endif
+
 /* -------------------------------------------------------------------------- */
 /*
   __lora_hal.c